@@ -1,29 +1,197 @@
+#include <cerrno>
+#include <cstdlib>
 #include <cstring>
 #include "LoadedProgram.h"
 #include "Executor.h"
 #include "BasicBuiltin.h"
+#include "ArrayBuiltin.h"
+#include "NumericBuiltin.h"
+#include "DictBuiltin.h"
+#include "BitsetBuiltin.h"
+#include "ArrayKernels.h"
+#include "MatrixKernels.h"
+#include "Profile.h"
 #include "File.h"
+#include "Allocator.h"
 
 using namespace AST;
 
+static void usage(const char *self)
+{
+  cout.printf("Usage: %s [options] <file.msl>\n", self);
+  cout.printf("Options:\n");
+  cout.printf("  -O0                  disable optimization passes\n");
+  cout.printf("  -profile-gen <file>  record an execution profile to <file>\n");
+  cout.printf("  -profile-use <file>  warm-start from a recorded profile\n");
+  cout.printf("  -gc-pause <us>       limit garbage collection pauses, 0 for none\n");
+  cout.printf("  -heap-limit <size>   fail past size bytes of arrays, K, M or G\n");
+  cout.printf("                       suffixed, 0 for none\n");
+  cout.printf("  -stats               print optimizer and memory statistics\n");
+  cout.printf("Environment:\n");
+  cout.printf("  MSL_GC_STRESS=1      collect garbage after every allocation\n");
+  cout.printf("  MSL_ALLOCATOR=<name> slab (default), huge: slab with large arrays\n");
+  cout.printf("                       on huge pages, or malloc\n");
+  cout.printf("  MSL_SIMD=<level>     sse2 or scalar: narrower bulk array kernels\n");
+  cout.printf("  MSL_THREADS=<n>      threads for large matrix kernels, 1 by default\n");
+}
+
+// A byte count, optionally in K, M or G; false if it does not fit
+static bool parseSize(const char *str, size_t &size)
+{
+  char *end;
+  errno = 0;
+  long n = strtol(str, &end, 10);
+  if (end == str || n < 0 || errno == ERANGE)
+    return false;
+  size = n;
+  static const char *units = "KMG";
+  const char *unit = *end == '\0'? NULL : strchr(units, *end);
+  if (unit != NULL)
+  {
+    int shift = 10 * (unit - units + 1);
+    if (size > static_cast<size_t>(-1) >> shift)
+      return false;
+    size <<= shift;
+    end++;
+  }
+  return *end == '\0';
+}
+
 int main(int argc, char **argv)
 {
-  if (argc != 2)
+  const char *filename = NULL;
+  const char *profileGen = NULL;
+  const char *profileUse = NULL;
+  bool optimize = true;
+  bool stats = false;
+  long gcPause = GarbageCollector::DefaultPauseLimit;
+  size_t heapLimit = 0;
+  for (int i=1; i<argc; i++)
+  {
+    if (0 == strcmp(argv[i], "-O0"))
+      optimize = false;
+    else if (0 == strcmp(argv[i], "-stats"))
+      stats = true;
+    else if (0 == strcmp(argv[i], "-gc-pause") && i+1 < argc)
+    {
+      char *end;
+      gcPause = strtol(argv[++i], &end, 10);
+      if (*end != '\0' || gcPause < 0)
+      {
+        usage(argv[0]);
+        return 1;
+      }
+    }
+    else if (0 == strcmp(argv[i], "-heap-limit") && i+1 < argc)
+    {
+      if (!parseSize(argv[++i], heapLimit))
+      {
+        usage(argv[0]);
+        return 1;
+      }
+    }
+    else if (0 == strcmp(argv[i], "-profile-gen") && i+1 < argc)
+      profileGen = argv[++i];
+    else if (0 == strcmp(argv[i], "-profile-use") && i+1 < argc)
+      profileUse = argv[++i];
+    else if (argv[i][0] != '-' && filename == NULL)
+      filename = argv[i];
+    else
+    {
+      usage(argv[0]);
+      return 1;
+    }
+  }
+  if (filename == NULL)
   {
-    cout.printf("Usage: %s <file.msl>\n", argv[0]);
+    usage(argv[0]);
     return 1;
   }
 
-  const char *filename = argv[1];
   try
   {
-    LoadedProgram program(filename);
+    LoadedProgram program(filename, optimize);
+
+    Profile profile(program, program.sourceHash());
+    if (profileUse != NULL)
+    {
+      try
+      {
+        profile.load(profileUse);
+        profile.specialize(program);
+      }
+      catch (const File::Exception &e)
+      {
+        cerr.printf("%s: %s, starting cold\n", profileUse, strerror(e.code()));
+      }
+      catch (const Profile::Exception &e)
+      {
+        cerr.printf("%s: %s, starting cold\n", profileUse, e.text());
+      }
+    }
 
     BasicBuiltin builtins(program.strings());
+    ArrayBuiltin arrayBuiltins(program.strings());
+    NumericBuiltin numericBuiltins(program.strings());
+    DictBuiltin dictBuiltins(program.strings());
+    BitsetBuiltin bitsetBuiltins(program.strings());
 
     Executor executor(program, program.strings());
     executor.addBuiltin(&builtins);
+    executor.addBuiltin(&arrayBuiltins);
+    executor.addBuiltin(&numericBuiltins);
+    executor.addBuiltin(&dictBuiltins);
+    executor.addBuiltin(&bitsetBuiltins);
+    executor.gc().setPauseLimit(gcPause);
+    executor.setHeapLimit(heapLimit);
+    if (profileGen != NULL)
+      executor.setProfile(&profile);
     executor.run("main");
+
+    if (profileGen != NULL)
+      profile.save(profileGen);
+
+    if (stats)
+    {
+      const LoadedProgram::LoadStats &load = program.loadStats();
+      cerr.printf("load: %zu chars, %zu tokens in %lu us (%.1f MB/s)\n",
+          load.chars, load.tokens, load.micros,
+          load.micros == 0? 0.0 : static_cast<double>(load.chars) / load.micros);
+      const Optimizer::Stats &opt = program.optimizerStats();
+      cerr.printf("arrays: %u scalar-replaced, %u frame-allocated sites\n",
+          opt.scalarArrays, opt.frameArrays);
+      cerr.printf("arrays: %zu allocated, %zu freed\n", 
+          executor.arrays().allocCount(), executor.arrays().freeCount());
+      cerr.printf("arrays: %zu cloned, %zu copied on write\n",
+          executor.arrays().cloneCount(), executor.arrays().unshareCount());
+      cerr.printf("arrays: bulk kernels %s, matrix kernels on %zu threads\n",
+          ArrayKernels::levelName(), MatrixKernels::threads());
+      const GarbageCollector::Stats &gc = executor.gc().stats();
+      cerr.printf("gc: %zu minor, %zu major (%zu forced) collections in %zu slices%s\n",
+          gc.minorCollections, gc.collections, gc.forcedCollections, gc.slices, 
+          executor.gc().stress()? " (stress)" : "");
+      size_t nursery = executor.arrays().nurseryBytes();
+      size_t promoted = executor.arrays().promotedBytes();
+      cerr.printf("gc: %zu of %zu nursery bytes promoted (%.1f%%)\n", promoted, nursery,
+          nursery == 0? 0.0 : 100.0 * promoted / nursery);
+      cerr.printf("gc: %zu arrays (%zu bytes) reclaimed by major collections\n",
+          gc.arraysReclaimed, gc.bytesReclaimed);
+      cerr.printf("gc: pauses %lu us total, %lu us max\n", gc.totalPause, gc.maxPause);
+      const size_t last = GarbageCollector::PauseBuckets - 1;
+      for (size_t i=0; i<=last; i++)
+        if (gc.pauses[i] != 0)
+          cerr.printf("gc: %s%6lu us %zu\n", i < last? "< " : ">=", 
+              1UL << (i < last? i : i-1), gc.pauses[i]);
+      const ArrayStorage &arrays = executor.arrays();
+      cerr.printf("heap: %zu bytes live, %zu peak", arrays.liveBytes(), arrays.peakBytes());
+      if (arrays.limit() != 0)
+        cerr.printf(", limit %zu", arrays.limit());
+      cerr.printf("\n");
+      const Allocator *allocator = Allocator::instance();
+      cerr.printf("memory: %zu bytes in use, %zu reserved, %.1f%% fragmentation (%s)\n",
+          allocator->bytesInUse(), allocator->bytesReserved(), 
+          100.0 * allocator->fragmentation(), allocator->name());
+    }
   }
   catch (const File::Exception &e)
   {
@@ -43,4 +211,3 @@ int main(int argc, char **argv)
   return 0;
 }
 
-
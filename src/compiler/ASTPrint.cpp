@@ -271,13 +271,17 @@ static void printInstr(File *dest, size_t addr, const Instruction &instr, String
   switch (instr.opcode)
   {
 #define INSTR(opcode) case Instruction::opcode: \
-    dest->printf("%04zu: %-20s\n", addr, #opcode); break
+    dest->printf("%04zu: %-24s\n", addr, #opcode); break
 
 #define INSTR_G(opcode, fmt, val) case Instruction::opcode: \
-    dest->printf("%04zu: %-20s"fmt"\n", addr, #opcode, val); break
+    dest->printf("%04zu: %-24s"fmt"\n", addr, #opcode, val); break
 
 #define INSTR_A(opcode) case Instruction::opcode: \
-    dest->printf("%04zu: %-20s%s\n", addr, #opcode, strings->str(instr.arg.atom)); break
+    dest->printf("%04zu: %-24s%s\n", addr, #opcode, strings->str(instr.arg.atom)); break
+
+#define INSTR_C(opcode) case Instruction::opcode: \
+    dest->printf("%04zu: %-24s%s %u\n", addr, #opcode, strings->str(instr.arg.cell.atom), \
+        instr.arg.cell.rank); break
 
     INSTR_A(PushVar);
     INSTR_G(PushInt, "%d", instr.arg.intval);
@@ -285,8 +289,12 @@ static void printInstr(File *dest, size_t addr, const Instruction &instr, String
     INSTR_G(PushBool, "%s", (instr.arg.boolval?"TRUE":"FALSE"));
     INSTR_A(PushString);
     INSTR_A(PushArrayItem);
+    INSTR_A(PushArrayItemUnchecked);
+    INSTR_C(PushArrayCell);
     INSTR_A(PopVar);
     INSTR_A(PopArrayItem);
+    INSTR_A(PopArrayItemUnchecked);
+    INSTR_C(PopArrayCell);
     INSTR(Dup);
     INSTR(PopDelete);
     INSTR(TupOpen);
@@ -300,15 +308,29 @@ static void printInstr(File *dest, size_t addr, const Instruction &instr, String
     INSTR(Mod);
     INSTR(And);
     INSTR(Or);
+    INSTR(ShiftRight);
+    INSTR(BitAnd);
     INSTR(TestLess);
     INSTR(TestGreater);
     INSTR(TestLessEqual);
     INSTR(TestGreaterEqual);
     INSTR(TestEqual);
+    INSTR(AddInt);
+    INSTR(SubInt);
+    INSTR(MulInt);
+    INSTR(DivInt);
+    INSTR(ModInt);
+    INSTR(TestLessInt);
+    INSTR(TestGreaterInt);
+    INSTR(TestLessEqualInt);
+    INSTR(TestGreaterEqualInt);
+    INSTR(TestEqualInt);
     INSTR_G(Jump, "@%04zu", instr.arg.addr);
     INSTR_G(JumpIfNot, "@%04zu", instr.arg.addr);
     INSTR_A(Call);
     INSTR(Return);
+    INSTR_G(GuardArrayRange, "@%04zu", instr.arg.addr);
+    INSTR(AllocFrameArray);
     INSTR(Trap);
     case Instruction::Trace: 
       printTree(dest, instr.arg.trace);
@@ -317,6 +339,7 @@ static void printInstr(File *dest, size_t addr, const Instruction &instr, String
 #undef INSTR
 #undef INSTR_G
 #undef INSTR_A
+#undef INSTR_C
   }
 }
 
@@ -0,0 +1,305 @@
+#include <climits>
+#include "BoundsCheckEliminator.h"
+
+BoundsCheckEliminator::BoundsCheckEliminator(Program &prog, Optimizer &optimizer)
+  : m_prog(prog), m_strings(optimizer.strings()),
+    m_array(optimizer.builtin("array")),
+    m_intarray(optimizer.builtin("intarray")),
+    m_realarray(optimizer.builtin("realarray")),
+    m_sparse(optimizer.builtin("sparse")),
+    m_size(optimizer.builtin("size"))
+{
+}
+
+size_t BoundsCheckEliminator::optimize(size_t begin, size_t end)
+{
+  // Loops keep their order between rebuilds of the graph,
+  // see LoopOptimizer::optimize
+  for (size_t l=0; ; l++)
+  {
+    FlowGraph graph(m_prog, begin, end);
+    if (l >= graph.loopCount())
+      break;
+    CodeAnalysis info(m_prog, graph);
+    CodeEditor editor(m_prog, begin, end);
+    eliminateChecks(info, graph.loop(l), editor);
+    if (!editor.empty())
+      end = editor.apply();
+  }
+  return end;
+}
+
+static bool contains(const Vector<StringTable::Ref> &vars, StringTable::Ref var)
+{
+  for (size_t i=0; i<vars.size(); i++)
+    if (vars[i] == var)
+      return true;
+  return false;
+}
+
+void BoundsCheckEliminator::eliminateChecks(const CodeAnalysis &info,
+    const FlowGraph::Loop &loop, CodeEditor &editor)
+{
+  const FlowGraph &graph = info.graph();
+  LoopFacts facts;
+  for (size_t addr = loop.first; addr <= loop.last; addr++)
+  {
+    const Instruction &instr = m_prog[addr];
+    if (!graph.inLoop(loop, addr))
+      continue;
+    if (instr.opcode == Instruction::PopVar && !contains(facts.written, instr.arg.atom))
+      facts.written.push_back(instr.arg.atom);
+    else if (instr.opcode == Instruction::Call)
+      facts.hasCall = true;
+  }
+
+  Induction ind;
+  if (!findInduction(info, loop, facts, ind))
+    return;
+
+  // One guard per array and offset
+  bool guarded = graph.hasPreheaderSlot(loop);
+  Vector<Access> guards;
+  for (size_t addr = loop.first; addr <= loop.last; addr++)
+  {
+    Access access;
+    if (!findAccess(info, loop, facts, ind, addr, access))
+      continue;
+
+    if (!provenInRange(info, ind, access))
+    {
+      // The guard holds on entry only, and a call may grow the array
+      // sizing the loop past this one
+      bool sizeBound = ind.boundEnd != ind.boundStart;
+      if (!guarded || (sizeBound && facts.hasCall))
+        continue;
+      bool found = false;
+      for (size_t i=0; i<guards.size() && !found; i++)
+        found = guards[i].array == access.array && guards[i].offset == access.offset;
+      if (!found)
+        guards.push_back(access);
+    }
+
+    Instruction &instr = m_prog[addr];
+    instr.opcode = (instr.opcode == Instruction::PushArrayItem)?
+      Instruction::PushArrayItemUnchecked : Instruction::PopArrayItemUnchecked;
+  }
+
+  CodeEditor::Code preheader;
+  for (size_t i=0; i<guards.size(); i++)
+  {
+    preheader.push_back(Instruction(Instruction::PushVar, Atom(guards[i].array, m_strings)));
+    preheader.push_back(Instruction(Instruction::PushVar, Atom(ind.var, m_strings)));
+    preheader.push_back(Instruction(Instruction::PushInt, guards[i].offset));
+    for (size_t addr = ind.boundStart; addr <= ind.boundEnd; addr++)
+      preheader.push_back(m_prog[addr]);
+    preheader.push_back(Instruction(Instruction::PushInt, ind.adjust + guards[i].offset));
+    preheader.push_back(Instruction(Instruction::GuardArrayRange, loop.last + 1));
+  }
+  if (!preheader.empty())
+    editor.insertPreheader(loop.first, loop.last, preheader);
+}
+
+bool BoundsCheckEliminator::isInvariant(const CodeAnalysis &info,
+    const LoopFacts &facts, StringTable::Ref var) const
+{
+  // Callees may assign globals
+  return !contains(facts.written, var) && !(info.isGlobal(var) && facts.hasCall);
+}
+
+bool BoundsCheckEliminator::onlyDef(const CodeAnalysis &info,
+    StringTable::Ref var, size_t &def) const
+{
+  unsigned int defs = 0;
+  for (size_t addr = info.graph().begin(); addr < info.graph().end(); addr++)
+    if (m_prog[addr].opcode == Instruction::PopVar && m_prog[addr].arg.atom == var)
+    {
+      def = addr;
+      defs++;
+    }
+  return defs == 1 && !info.isGlobal(var);
+}
+
+// Like CodeAnalysis::operandStart, also taking [PushVar A][Call size]
+bool BoundsCheckEliminator::operandStart(const CodeAnalysis &info,
+    size_t addr, size_t &start) const
+{
+  const FlowGraph &graph = info.graph();
+  if (addr >= graph.begin() + 2
+      && m_prog[addr-1].opcode == Instruction::Call && m_prog[addr-1].arg.atom == m_size
+      && m_prog[addr-2].opcode == Instruction::PushVar
+      && graph.blockOf(addr-2) == graph.blockOf(addr))
+  {
+    start = addr-2;
+    return true;
+  }
+  return info.operandStart(addr, start);
+}
+
+bool BoundsCheckEliminator::findBound(const CodeAnalysis &info,
+    const LoopFacts &facts, size_t header, size_t start, size_t end) const
+{
+  const Instruction &first = m_prog[start];
+  if (start == end && first.opcode == Instruction::PushInt)
+    return true;
+  return first.opcode == Instruction::PushVar
+    && isInvariant(info, facts, first.arg.atom)
+    && info.assignedBefore(first.arg.atom, header)
+    && (start == end || m_prog[end].opcode == Instruction::Call);
+}
+
+bool BoundsCheckEliminator::findInduction(const CodeAnalysis &info,
+    const FlowGraph::Loop &loop, const LoopFacts &facts, Induction &ind) const
+{
+  const FlowGraph &graph = info.graph();
+  const FlowGraph::Block &header = graph.block(loop.header);
+
+  // The header ends with the loop test: [left][right][test][JumpIfNot exit]
+  size_t jump = header.end - 1;
+  if (jump < header.begin + 3
+      || m_prog[jump].opcode != Instruction::JumpIfNot
+      || graph.inLoop(loop, m_prog[jump].arg.addr)
+      || !graph.inLoop(loop, header.end))
+    return false;
+  size_t test = jump - 1;
+  size_t left, right;
+  if (!operandStart(info, test, right) || !operandStart(info, right, left))
+    return false;
+
+  size_t var, boundStart, boundEnd;
+  switch (Instruction::genericVariant(m_prog[test].opcode))
+  {
+    case Instruction::TestGreaterEqual: // bound >= var
+    case Instruction::TestGreater:      // bound > var
+      boundStart = left;
+      boundEnd = right - 1;
+      var = right;
+      if (test - right != 1)
+        return false;
+      break;
+    case Instruction::TestLessEqual:    // var <= bound
+    case Instruction::TestLess:         // var < bound
+      var = left;
+      boundStart = right;
+      boundEnd = test - 1;
+      if (right - left != 1)
+        return false;
+      break;
+    default:
+      return false;
+  }
+  Instruction::Opcode op = Instruction::genericVariant(m_prog[test].opcode);
+  ind.adjust = (op == Instruction::TestGreater || op == Instruction::TestLess)? -1 : 0;
+  ind.boundStart = boundStart;
+  ind.boundEnd = boundEnd;
+  if (m_prog[var].opcode != Instruction::PushVar
+      || !findBound(info, facts, header.begin, boundStart, boundEnd))
+    return false;
+
+  // The only assignment in the loop is var = var + step, with step > 0,
+  // right before going back to the header
+  ind.var = m_prog[var].arg.atom;
+  unsigned int defs = 0;
+  for (size_t addr = loop.first; addr <= loop.last; addr++)
+    if (m_prog[addr].opcode == Instruction::PopVar && m_prog[addr].arg.atom == ind.var
+        && graph.inLoop(loop, addr))
+    {
+      ind.def = addr;
+      defs++;
+    }
+  if (defs != 1 || info.isGlobal(ind.var) || !info.assignedBefore(ind.var, header.begin))
+    return false;
+  const FlowGraph::Block &latch = graph.block(graph.blockOf(ind.def));
+  size_t d = ind.def;
+  return latch.succs.size() == 1 && latch.succs[0] == loop.header
+    && d >= latch.begin + 3
+    && m_prog[d-3].opcode == Instruction::PushVar && m_prog[d-3].arg.atom == ind.var
+    && m_prog[d-2].opcode == Instruction::PushInt && m_prog[d-2].arg.intval > 0
+    && Instruction::genericVariant(m_prog[d-1].opcode) == Instruction::Add;
+}
+
+bool BoundsCheckEliminator::findAccess(const CodeAnalysis &info,
+    const FlowGraph::Loop &loop, const LoopFacts &facts, const Induction &ind,
+    size_t addr, Access &access) const
+{
+  const FlowGraph &graph = info.graph();
+  const Instruction &instr = m_prog[addr];
+  if ((instr.opcode != Instruction::PushArrayItem && instr.opcode != Instruction::PopArrayItem)
+      || !graph.inLoop(loop, addr))
+    return false;
+
+  // Past the loop test, and not past the step of the induction variable
+  size_t header = graph.block(loop.header).begin;
+  size_t body = graph.blockOf(graph.block(loop.header).end);
+  size_t b = graph.blockOf(addr);
+  if (!graph.dominates(body, b) || (b == graph.blockOf(ind.def) && addr > ind.def))
+    return false;
+
+  access.addr = addr;
+  access.array = instr.arg.atom;
+  if (!isInvariant(info, facts, access.array)
+      || !info.assignedBefore(access.array, header))
+    return false;
+
+  // The index is [PushVar var] or [PushVar var][PushInt c][Add/Sub]
+  size_t start;
+  if (!info.operandStart(addr, start)
+      || m_prog[start].opcode != Instruction::PushVar
+      || m_prog[start].arg.atom != ind.var)
+    return false;
+  if (addr - start == 1)
+  {
+    access.offset = 0;
+    return true;
+  }
+  if (addr - start != 3 || m_prog[start+1].opcode != Instruction::PushInt)
+    return false;
+  int c = m_prog[start+1].arg.intval;
+  switch (Instruction::genericVariant(m_prog[start+2].opcode))
+  {
+    case Instruction::Add: access.offset = c; return true;
+    case Instruction::Sub: access.offset = -c; return c != INT_MIN;
+    default:               return false;
+  }
+}
+
+bool BoundsCheckEliminator::provenInRange(const CodeAnalysis &info,
+    const Induction &ind, const Access &access) const
+{
+  // From below: var never gets under its lower bound
+  int min;
+  if (!info.lowerBoundVar(ind.var, min)
+      || static_cast<long>(min) + access.offset < 1)
+    return false;
+
+  // From above: var + offset <= bound + adjust + offset <= size
+  long slack = static_cast<long>(ind.adjust) + access.offset;
+  const Instruction &bound = m_prog[ind.boundStart];
+  if (ind.boundEnd != ind.boundStart) // size A
+    return bound.arg.atom == access.array && slack <= 0;
+
+  // The array's only assignment is array = array N (or intarray N,
+  // realarray N, sparse N), which must reach the loop, and the same N
+  // bounds the loop
+  const FlowGraph &graph = info.graph();
+  size_t def;
+  if (!onlyDef(info, access.array, def) || def < graph.begin() + 2
+      || !isAlloc(m_prog[def-1])
+      || graph.blockOf(def-2) != graph.blockOf(def)
+      || !graph.dominates(graph.blockOf(def), graph.blockOf(ind.boundStart)))
+    return false;
+  const Instruction &size = m_prog[def-2];
+  if (bound.opcode == Instruction::PushInt)
+    return size.opcode == Instruction::PushInt
+      && bound.arg.intval + slack <= size.arg.intval;
+
+  // N keeps its value: it is assigned once, and not inside any loop
+  size_t sizeDef;
+  if (size.opcode != Instruction::PushVar || size.arg.atom != bound.arg.atom
+      || slack > 0 || !onlyDef(info, size.arg.atom, sizeDef))
+    return false;
+  for (size_t l=0; l<graph.loopCount(); l++)
+    if (graph.inLoop(graph.loop(l), sizeDef))
+      return false;
+  return true;
+}
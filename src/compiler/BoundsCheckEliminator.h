@@ -0,0 +1,94 @@
+#ifndef BOUNDSCHECKELIMINATOR_H
+#define BOUNDSCHECKELIMINATOR_H
+
+#include "Program.h"
+#include "FlowGraph.h"
+#include "CodeAnalysis.h"
+#include "CodeEditor.h"
+#include "Optimizer.h"
+
+/**
+ * Array bounds-check elimination over the code of one function.
+ *
+ * The test of a loop bounds its induction variable from above, and the
+ * variable only grows from its value on entry. An access $A (I+c) in
+ * the loop body therefore stays in range when:
+ * - the bounds prove it: I has a positive lower bound in the whole
+ *   function, and the loop bound is size A, or the very variable or
+ *   constant A was allocated with;
+ * - or else, when a GuardArrayRange in the preheader finds the whole
+ *   range valid on loop entry. A failed guard turns the accesses of
+ *   the loop back into checked ones for good. A loop bounded by the
+ *   size of another array must not call anything, as a call may grow
+ *   that array alone.
+ * Such accesses become PushArrayItemUnchecked/PopArrayItemUnchecked.
+ *
+ * Sizes may grow in the loop, but not shrink: once any array shrinks,
+ * the executor makes every access a checked one again for good.
+ */
+class BoundsCheckEliminator
+{
+  public:
+    BoundsCheckEliminator(Program &prog, Optimizer &optimizer);
+
+    // Optimize the function in [begin, end), returns its new end
+    size_t optimize(size_t begin, size_t end);
+
+  private:
+    struct LoopFacts
+    {
+      LoopFacts(): hasCall(false) {}
+      Vector<StringTable::Ref> written;
+      bool hasCall;
+    };
+    // In the loop body, var <= bound + adjust, where the bound is
+    // computed by [boundStart, boundEnd]
+    struct Induction
+    {
+      StringTable::Ref var;
+      size_t def; // The only assignment to var in the loop
+      size_t boundStart;
+      size_t boundEnd;
+      int adjust;
+    };
+    // $array (var + offset)
+    struct Access
+    {
+      size_t addr;
+      StringTable::Ref array;
+      int offset;
+    };
+
+    void eliminateChecks(const CodeAnalysis &info, const FlowGraph::Loop &loop,
+        CodeEditor &editor);
+    bool findInduction(const CodeAnalysis &info, const FlowGraph::Loop &loop,
+        const LoopFacts &facts, Induction &ind) const;
+    bool operandStart(const CodeAnalysis &info, size_t addr, size_t &start) const;
+    bool findBound(const CodeAnalysis &info, const LoopFacts &facts,
+        size_t header, size_t start, size_t end) const;
+    bool findAccess(const CodeAnalysis &info, const FlowGraph::Loop &loop,
+        const LoopFacts &facts, const Induction &ind, size_t addr,
+        Access &access) const;
+    bool provenInRange(const CodeAnalysis &info, const Induction &ind,
+        const Access &access) const;
+
+    bool isInvariant(const CodeAnalysis &info, const LoopFacts &facts,
+        StringTable::Ref var) const;
+    bool onlyDef(const CodeAnalysis &info, StringTable::Ref var, size_t &def) const;
+    bool isAlloc(const Instruction &instr) const
+    {
+      return instr.opcode == Instruction::Call && (instr.arg.atom == m_array
+          || instr.arg.atom == m_intarray || instr.arg.atom == m_realarray
+          || instr.arg.atom == m_sparse);
+    }
+
+    Program &m_prog;
+    StringTable *m_strings;
+    StringTable::Ref m_array;
+    StringTable::Ref m_intarray;
+    StringTable::Ref m_realarray;
+    StringTable::Ref m_sparse;
+    StringTable::Ref m_size;
+};
+
+#endif // BOUNDSCHECKELIMINATOR_H
@@ -0,0 +1,375 @@
+#include <climits>
+#include "CodeAnalysis.h"
+#include "Stack.h"
+
+CodeAnalysis::CodeAnalysis(const Program &prog, const FlowGraph &graph)
+  : m_prog(prog), m_graph(graph)
+{
+  inferTypes();
+  inferBounds();
+}
+
+// ========= Instructions
+
+bool CodeAnalysis::isPure(const Instruction &instr)
+{
+  switch (instr.opcode)
+  {
+    case Instruction::PushVar:
+    case Instruction::PushInt:
+    case Instruction::PushReal:
+    case Instruction::PushBool:
+    case Instruction::PushString:
+    case Instruction::PushArrayItem:
+    case Instruction::PushArrayItemUnchecked:
+      return true;
+    default:
+      return instr.isBinOp() || instr.isIntOp();
+  }
+}
+
+unsigned int CodeAnalysis::operandCount(const Instruction &instr)
+{
+  if (instr.isBinOp() || instr.isIntOp())
+    return 2;
+  else if (instr.isArrayRead())
+    return 1;
+  else
+    return 0;
+}
+
+bool CodeAnalysis::sameInstr(const Instruction &a, const Instruction &b)
+{
+  if (a.opcode != b.opcode)
+    return false;
+  switch (a.opcode)
+  {
+    case Instruction::PushInt:   return a.arg.intval == b.arg.intval;
+    case Instruction::PushReal:  return a.arg.realval == b.arg.realval;
+    case Instruction::PushBool:  return a.arg.boolval == b.arg.boolval;
+    case Instruction::Jump:
+    case Instruction::JumpIfNot:
+    case Instruction::GuardArrayRange: return a.arg.addr == b.arg.addr;
+    case Instruction::PushVar:
+    case Instruction::PushString:
+    case Instruction::PushArrayItem:
+    case Instruction::PushArrayItemUnchecked:
+    case Instruction::PopVar:
+    case Instruction::PopArrayItem:
+    case Instruction::PopArrayItemUnchecked:
+    case Instruction::Call:      return a.arg.atom == b.arg.atom;
+    default:                     return true;
+  }
+}
+
+// ========= Expressions
+
+bool CodeAnalysis::exprStart(size_t end, size_t &start) const
+{
+  unsigned int need = 1;
+  for (size_t i = end; ; i--)
+  {
+    const Instruction &instr = m_prog[i];
+    if (!isPure(instr))
+      return false;
+    need = need - 1 + operandCount(instr);
+    if (need == 0)
+    {
+      start = i;
+      return true;
+    }
+    // Operands must be computed within the block
+    if (i == m_graph.begin() || m_graph.isLeader(i))
+      return false;
+  }
+}
+
+bool CodeAnalysis::operandStart(size_t addr, size_t &start) const
+{
+  if (addr == m_graph.begin() || m_graph.isLeader(addr))
+    return false;
+  return exprStart(addr-1, start);
+}
+
+bool CodeAnalysis::sameExpr(size_t start1, size_t start2, size_t length) const
+{
+  for (size_t i=0; i<length; i++)
+    if (!sameInstr(m_prog[start1+i], m_prog[start2+i]))
+      return false;
+  return true;
+}
+
+static unsigned int numResult(unsigned int a, unsigned int b)
+{
+  unsigned int r = 0;
+  if ((a & CodeAnalysis::IntType) && (b & CodeAnalysis::IntType))
+    r |= CodeAnalysis::IntType;
+  if (((a & CodeAnalysis::RealType) && (b & CodeAnalysis::NumType))
+      || ((b & CodeAnalysis::RealType) && (a & CodeAnalysis::NumType)))
+    r |= CodeAnalysis::RealType;
+  // Elementwise, on an array and an array or a number
+  if (((a & CodeAnalysis::ArrayType) && (b & (CodeAnalysis::NumType | CodeAnalysis::ArrayType)))
+      || ((b & CodeAnalysis::ArrayType) && (a & CodeAnalysis::NumType)))
+    r |= CodeAnalysis::ArrayType;
+  return r;
+}
+
+static bool within(unsigned int types, unsigned int allowed)
+{
+  return (types & ~allowed) == 0;
+}
+
+CodeAnalysis::Operand CodeAnalysis::evaluate(size_t start, size_t end, bool &trap,
+    const VarList &numeric) const
+{
+  static const unsigned int comparable = 
+    NumType | BoolType | (1u << Value::String);
+
+  Stack<Operand> stack;
+  trap = false;
+  for (size_t i = start; i <= end; i++)
+  {
+    const Instruction &instr = m_prog[i];
+    switch (instr.opcode)
+    {
+      case Instruction::PushInt:
+        stack.push(Operand(IntType, true, instr.arg.intval));
+        continue;
+      case Instruction::PushReal:
+        stack.push(Operand(RealType));
+        continue;
+      case Instruction::PushBool:
+        stack.push(Operand(BoolType));
+        continue;
+      case Instruction::PushString:
+        stack.push(Operand(1u << Value::String));
+        continue;
+      case Instruction::PushVar:
+      {
+        Operand var(varTypes(instr.arg.atom));
+        var.bounded = lowerBoundVar(instr.arg.atom, var.min);
+        for (size_t n=0; n<numeric.size(); n++)
+          if (numeric[n] == instr.arg.atom && (var.types & NumType))
+            var.types &= NumType;
+        stack.push(var);
+      } continue;
+      case Instruction::PushArrayItem:
+      case Instruction::PushArrayItemUnchecked:
+        stack.pop();
+        stack.push(Operand(AnyType));
+        trap = true;
+        continue;
+      default:
+        break;
+    }
+
+    Operand b = stack.top();
+    stack.pop();
+    Operand a = stack.top();
+    stack.pop();
+    Operand r(0);
+    bool safeDivisor = b.isConst && b.value != 0 && b.value != -1;
+    Instruction::Opcode op = Instruction::genericVariant(instr.opcode);
+    switch (op)
+    {
+      case Instruction::Add:
+        r.types = numResult(a.types, b.types);
+        // Adding a non-negative never lowers the bound, so the 
+        // optimistic inference of bounds settles
+        if (a.bounded && b.bounded && (a.min >= 0 || b.min >= 0))
+        {
+          r.bounded = true;
+          long sum = static_cast<long>(a.min) + b.min;
+          r.min = (a.min == INT_MAX || b.min == INT_MAX)? INT_MAX
+            : (sum < INT_MIN)? INT_MIN : static_cast<int>(sum);
+        }
+        trap = trap || !within(a.types | b.types, NumType);
+        break;
+      case Instruction::Sub:
+      case Instruction::Mul:
+        r.types = numResult(a.types, b.types);
+        trap = trap || !within(a.types | b.types, NumType);
+        break;
+      case Instruction::Div:
+        r.types = numResult(a.types, b.types);
+        r.bounded = a.bounded && a.min >= 0 && b.isConst && b.value > 0;
+        trap = trap || !within(a.types | b.types, NumType)
+          || !(safeDivisor || a.types == RealType || b.types == RealType);
+        break;
+      case Instruction::Mod:
+      case Instruction::ShiftRight:
+      case Instruction::BitAnd:
+        r.types = (a.types && b.types)? IntType : 0;
+        r.bounded = a.bounded && a.min >= 0 && b.isConst && b.value > 0;
+        trap = trap || !within(a.types | b.types, IntType)
+          || (op == Instruction::Mod && !safeDivisor);
+        break;
+      case Instruction::And:
+      case Instruction::Or:
+        r.types = (a.types && b.types)? BoolType : 0;
+        trap = trap || !within(a.types | b.types, BoolType);
+        break;
+      case Instruction::TestEqual:
+        r.types = (a.types && b.types)? BoolType : 0;
+        trap = trap || !within(a.types | b.types, comparable);
+        break;
+      default: // Ordering tests
+        r.types = (a.types && b.types)? BoolType : 0;
+        trap = trap || !within(a.types | b.types, NumType);
+        break;
+    }
+    r.fresh = a.fresh || b.fresh || (r.types & ArrayType) != 0;
+    stack.push(r);
+  }
+  return stack.top();
+}
+
+unsigned int CodeAnalysis::exprTypes(size_t start, size_t end) const
+{
+  bool trap;
+  return evaluate(start, end, trap).types;
+}
+
+bool CodeAnalysis::mayTrap(size_t start, size_t end, const VarList &numeric) const
+{
+  bool trap;
+  evaluate(start, end, trap, numeric);
+  return trap;
+}
+
+bool CodeAnalysis::mayMakeArray(size_t start, size_t end, const VarList &numeric) const
+{
+  bool trap;
+  return evaluate(start, end, trap, numeric).fresh;
+}
+
+bool CodeAnalysis::isNonNegative(size_t start, size_t end) const
+{
+  int min;
+  return lowerBound(start, end, min) && min >= 0;
+}
+
+bool CodeAnalysis::lowerBound(size_t start, size_t end, int &min) const
+{
+  bool trap;
+  Operand r = evaluate(start, end, trap);
+  min = r.min;
+  return r.bounded && r.types == IntType;
+}
+
+// ========= Variables
+
+bool CodeAnalysis::isGlobal(StringTable::Ref var) const
+{
+  for (size_t i=0; i<m_prog.globalsCount(); i++)
+    if (m_prog.global(i) == var)
+      return true;
+  return false;
+}
+
+unsigned int CodeAnalysis::varTypes(StringTable::Ref var) const
+{
+  if (m_varTypes.count(var) == 0 || isGlobal(var))
+    return AnyType;
+  return m_varTypes[var];
+}
+
+bool CodeAnalysis::lowerBoundVar(StringTable::Ref var, int &min) const
+{
+  if (m_lowerBound.count(var) == 0 || m_lowerBound[var] == INT_MIN)
+    return false;
+  min = m_lowerBound[var];
+  return true;
+}
+
+bool CodeAnalysis::assignedBefore(StringTable::Ref var, size_t addr) const
+{
+  if (isGlobal(var))
+    return true;
+  size_t block = m_graph.blockOf(addr);
+  for (size_t a = m_graph.begin(); a < m_graph.end(); a++)
+  {
+    const Instruction &instr = m_prog[a];
+    if (instr.opcode != Instruction::PopVar || instr.arg.atom != var)
+      continue;
+    size_t b = m_graph.blockOf(a);
+    if (b == block? a < addr : m_graph.dominates(b, block))
+      return true;
+  }
+  return false;
+}
+
+void CodeAnalysis::inferTypes()
+{
+  // Optimistic: every assigned local starts with no types at all
+  for (size_t a = m_graph.begin(); a < m_graph.end(); a++)
+    if (m_prog[a].opcode == Instruction::PopVar && !isGlobal(m_prog[a].arg.atom))
+      m_varTypes[m_prog[a].arg.atom] = 0;
+
+  bool changed = true;
+  while (changed)
+  {
+    changed = false;
+    for (size_t a = m_graph.begin(); a < m_graph.end(); a++)
+    {
+      const Instruction &instr = m_prog[a];
+      if (instr.opcode != Instruction::PopVar || isGlobal(instr.arg.atom))
+        continue;
+      size_t start;
+      unsigned int t = AnyType;
+      if (operandStart(a, start))
+        t = exprTypes(start, a-1);
+      unsigned int &types = m_varTypes[instr.arg.atom];
+      if ((types | t) != types)
+      {
+        types |= t;
+        changed = true;
+      }
+    }
+  }
+
+  // Never assigned a value: reading it fails anyway
+  for (size_t a = m_graph.begin(); a < m_graph.end(); a++)
+    if (m_prog[a].opcode == Instruction::PopVar && !isGlobal(m_prog[a].arg.atom)
+        && m_varTypes[m_prog[a].arg.atom] == 0)
+      m_varTypes[m_prog[a].arg.atom] = AnyType;
+}
+
+void CodeAnalysis::inferBounds()
+{
+  // Optimistic: every assigned Int local starts at the top, and only
+  // its assignments lower the bound (INT_MIN stands for no bound)
+  for (size_t a = m_graph.begin(); a < m_graph.end(); a++)
+  {
+    const Instruction &instr = m_prog[a];
+    if (instr.opcode == Instruction::PopVar && !isGlobal(instr.arg.atom)
+        && varTypes(instr.arg.atom) == IntType)
+      m_lowerBound[instr.arg.atom] = INT_MAX;
+  }
+
+  bool changed = true;
+  while (changed)
+  {
+    changed = false;
+    for (size_t a = m_graph.begin(); a < m_graph.end(); a++)
+    {
+      const Instruction &instr = m_prog[a];
+      if (instr.opcode != Instruction::PopVar 
+          || m_lowerBound.count(instr.arg.atom) == 0
+          || m_lowerBound[instr.arg.atom] == INT_MIN)
+        continue;
+      size_t start;
+      int min;
+      if (!operandStart(a, start) || !lowerBound(start, a-1, min))
+      {
+        m_lowerBound[instr.arg.atom] = INT_MIN;
+        changed = true;
+      }
+      else if (min < m_lowerBound[instr.arg.atom])
+      {
+        m_lowerBound[instr.arg.atom] = min;
+        changed = true;
+      }
+    }
+  }
+}
@@ -0,0 +1,91 @@
+#ifndef CODEANALYSIS_H
+#define CODEANALYSIS_H
+
+#include "Map.h"
+#include "Program.h"
+#include "Value.h"
+#include "FlowGraph.h"
+
+/**
+ * Facts about the linear code of one function.
+ *
+ * Expressions are recovered from the stack code: a pure instruction 
+ * together with the instructions computing its operands forms a 
+ * contiguous span inside one basic block, pushing exactly one value.
+ *
+ * Variable facts are flow-insensitive: they hold for every 
+ * assignment in the function.
+ */
+class CodeAnalysis
+{
+  public:
+    // Type masks, built of 1 << Value::Type
+    static const unsigned int AnyType = ~0u;
+    static const unsigned int IntType = 1u << Value::Int;
+    static const unsigned int RealType = 1u << Value::Real;
+    static const unsigned int BoolType = 1u << Value::Bool;
+    static const unsigned int ArrayType = 1u << Value::Array;
+    static const unsigned int NumType = IntType | RealType;
+
+    CodeAnalysis(const Program &prog, const FlowGraph &graph);
+
+    // Instruction classes
+    static bool isPure(const Instruction &instr);
+    static unsigned int operandCount(const Instruction &instr);
+    static bool sameInstr(const Instruction &a, const Instruction &b);
+
+    const Program &program() const { return m_prog; }
+    const FlowGraph &graph() const { return m_graph; }
+
+    // Span [start, end] computing the value pushed by the pure 
+    // instruction at end
+    bool exprStart(size_t end, size_t &start) const;
+    // Span computing the topmost operand of the instruction at addr
+    bool operandStart(size_t addr, size_t &start) const;
+    bool sameExpr(size_t start1, size_t start2, size_t length) const;
+
+    typedef Vector<StringTable::Ref> VarList;
+
+    unsigned int exprTypes(size_t start, size_t end) const;
+    // Variables in numeric are known to hold numbers
+    bool mayTrap(size_t start, size_t end, const VarList &numeric = VarList()) const;
+    // Arithmetic on arrays allocates a new one each time it runs, so 
+    // such an expression may be neither shared nor moved
+    bool mayMakeArray(size_t start, size_t end, const VarList &numeric = VarList()) const;
+    bool isNonNegative(size_t start, size_t end) const;
+    // The expression always gives an Int >= min
+    bool lowerBound(size_t start, size_t end, int &min) const;
+
+    bool isGlobal(StringTable::Ref var) const;
+    unsigned int varTypes(StringTable::Ref var) const;
+    // Every assignment to var stores an Int >= min
+    bool lowerBoundVar(StringTable::Ref var, int &min) const;
+    // Some assignment to var dominates addr
+    bool assignedBefore(StringTable::Ref var, size_t addr) const;
+
+  private:
+    struct Operand
+    {
+      Operand(unsigned int t=AnyType, bool c=false, int v=0)
+        : types(t), bounded(c), min(v), isConst(c), value(v), fresh(false) {}
+      unsigned int types;
+      bool bounded;
+      int min;
+      bool isConst;
+      int value;
+      // Some array is allocated computing it
+      bool fresh;
+    };
+    Operand evaluate(size_t start, size_t end, bool &mayTrap, 
+        const VarList &numeric = VarList()) const;
+
+    void inferTypes();
+    void inferBounds();
+
+    const Program &m_prog;
+    const FlowGraph &m_graph;
+    Map<StringTable::Ref, unsigned int> m_varTypes;
+    Map<StringTable::Ref, int> m_lowerBound;
+};
+
+#endif // CODEANALYSIS_H
@@ -0,0 +1,103 @@
+#include "CodeEditor.h"
+
+void CodeEditor::replace(size_t first, size_t last, const Code &code)
+{
+  m_edits.push_back(Edit(Replace, first, last, code));
+}
+
+void CodeEditor::insertBefore(size_t addr, const Code &code)
+{
+  m_edits.push_back(Edit(Before, addr, addr, code));
+}
+
+void CodeEditor::insertAfter(size_t addr, const Code &code)
+{
+  m_edits.push_back(Edit(After, addr, addr, code));
+}
+
+void CodeEditor::insertPreheader(size_t header, size_t last, const Code &code)
+{
+  m_edits.push_back(Edit(Preheader, header, last, code));
+}
+
+const CodeEditor::Edit *CodeEditor::find(Kind kind, size_t addr) const
+{
+  for (size_t i=0; i<m_edits.size(); i++)
+    if (m_edits[i].kind == kind && m_edits[i].addr == addr)
+      return &m_edits[i];
+  return NULL;
+}
+
+void CodeEditor::emit(Code &out, Kind kind, size_t addr) const
+{
+  for (size_t i=0; i<m_edits.size(); i++)
+    if (m_edits[i].kind == kind && m_edits[i].addr == addr)
+      for (size_t j=0; j<m_edits[i].code.size(); j++)
+        out.push_back(m_edits[i].code[j]);
+}
+
+size_t CodeEditor::apply()
+{
+  size_t n = m_end - m_begin;
+  // New positions of the preheader, the inserted prefix and
+  // the instruction itself, per original address (one past the end too)
+  Vector<size_t> pre(n+1), mid(n+1), at(n+1);
+  // Original address each instruction of the new code comes from
+  Vector<size_t> origin;
+  Code code;
+
+  for (size_t addr = m_begin; addr <= m_end; addr++)
+  {
+    size_t i = addr - m_begin;
+    if (addr > m_begin)
+      emit(code, After, addr-1);
+    while (origin.size() < code.size())
+      origin.push_back(addr-1);
+    pre[i] = m_begin + code.size();
+    if (addr == m_end)
+    {
+      mid[i] = at[i] = pre[i];
+      break;
+    }
+    emit(code, Preheader, addr);
+    mid[i] = m_begin + code.size();
+    emit(code, Before, addr);
+    at[i] = m_begin + code.size();
+
+    const Edit *replaced = find(Replace, addr);
+    if (replaced != NULL)
+    {
+      emit(code, Replace, addr);
+      // Skip the replaced range
+      for (size_t j = addr+1; j <= replaced->last; j++)
+        pre[j-m_begin] = mid[j-m_begin] = at[j-m_begin] = at[i];
+      addr = replaced->last;
+    }
+    else
+      code.push_back(m_prog[addr]);
+    while (origin.size() < code.size())
+      origin.push_back(addr);
+  }
+
+  // Retarget code addresses, in the original and in the inserted code
+  for (size_t pos = 0; pos < code.size(); pos++)
+  {
+    Instruction &instr = code[pos];
+    if (!instr.hasAddress())
+      continue;
+    size_t target = instr.arg.addr;
+    if (target < m_begin || target > m_end)
+      continue;
+    size_t t = target - m_begin;
+    size_t landing = pre[t];
+    const Edit *preheader = find(Preheader, target);
+    if (preheader != NULL && origin[pos] >= target && origin[pos] <= preheader->last)
+      landing = mid[t];
+    instr.arg.addr = landing;
+  }
+
+  m_prog.splice(m_begin, m_end, code);
+  m_end = m_begin + code.size();
+  m_edits.clear();
+  return m_end;
+}
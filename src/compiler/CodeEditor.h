@@ -0,0 +1,59 @@
+#ifndef CODEEDITOR_H
+#define CODEEDITOR_H
+
+#include "Vector.h"
+#include "Program.h"
+
+/**
+ * Rewrites the code of one function in a Program.
+ *
+ * Edits are queued against the original addresses and applied at once.
+ * Code addresses are retargeted, and the code and entry points which 
+ * follow the function are relocated. Addresses in inserted code refer
+ * to the original code; inserted code must not contain jumps.
+ */
+class CodeEditor
+{
+  public:
+    typedef Vector<Instruction> Code;
+
+    CodeEditor(Program &prog, size_t begin, size_t end)
+      : m_prog(prog), m_begin(begin), m_end(end) {}
+
+    // Replace [first, last]; jumps into the range may only target first
+    void replace(size_t first, size_t last, const Code &code);
+    // Insert before addr; jumps to addr land on the inserted code
+    void insertBefore(size_t addr, const Code &code);
+    // Insert after addr; jumps to addr+1 land past the inserted code
+    void insertAfter(size_t addr, const Code &code);
+    // Insert a loop preheader before header; jumps to the header from
+    // within [header, last] land past the inserted code
+    void insertPreheader(size_t header, size_t last, const Code &code);
+
+    bool empty() const { return m_edits.empty(); }
+
+    // Apply all edits, returns the new end of the function
+    size_t apply();
+
+  private:
+    enum Kind { Replace, Before, After, Preheader };
+    struct Edit
+    {
+      Edit(Kind k=Replace, size_t a=0, size_t l=0, const Code &c=Code())
+        : kind(k), addr(a), last(l), code(c) {}
+      Kind kind;
+      size_t addr;
+      size_t last;
+      Code code;
+    };
+
+    void emit(Code &out, Kind kind, size_t addr) const;
+    const Edit *find(Kind kind, size_t addr) const;
+
+    Program &m_prog;
+    size_t m_begin;
+    size_t m_end;
+    Vector<Edit> m_edits;
+};
+
+#endif // CODEEDITOR_H
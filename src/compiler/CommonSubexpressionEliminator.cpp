@@ -0,0 +1,181 @@
+#include "CommonSubexpressionEliminator.h"
+#include "Stack.h"
+
+size_t CommonSubexpressionEliminator::optimize(size_t begin, size_t end)
+{
+  // Every rewrite removes the reuses of one expression
+  for (;;)
+  {
+    FlowGraph graph(m_prog, begin, end);
+    CodeAnalysis info(m_prog, graph);
+    CodeEditor editor(m_prog, begin, end);
+    if (!eliminateOne(info, editor))
+      break;
+    end = editor.apply();
+  }
+  return end;
+}
+
+static bool contains(const Vector<StringTable::Ref> &vars, StringTable::Ref var)
+{
+  for (size_t i=0; i<vars.size(); i++)
+    if (vars[i] == var)
+      return true;
+  return false;
+}
+
+bool CommonSubexpressionEliminator::eliminateOne(const CodeAnalysis &info,
+    CodeEditor &editor)
+{
+  const FlowGraph &graph = info.graph();
+  Vector<size_t> starts, ends;
+  for (size_t addr = graph.begin(); addr < graph.end(); addr++)
+  {
+    size_t start;
+    if (CodeAnalysis::operandCount(m_prog[addr]) > 0
+        && graph.isReachable(graph.blockOf(addr))
+        && info.exprStart(addr, start) && !info.mayMakeArray(start, addr))
+    {
+      starts.push_back(start);
+      ends.push_back(addr);
+    }
+  }
+
+  // The largest expression worth a temporary, the first one on a tie
+  size_t best = 0;
+  bool found = false;
+  Vector<size_t> uses;
+  for (size_t i=0; i<starts.size(); i++)
+  {
+    size_t length = ends[i] - starts[i];
+    if (found && length <= ends[best] - starts[best])
+      continue;
+
+    Reads r = reads(info, starts[i], ends[i]);
+    Vector<size_t> available;
+    for (size_t j=i+1; j<starts.size(); j++)
+      if (ends[j] - starts[j] == length && starts[j] > ends[i]
+          && info.sameExpr(starts[i], starts[j], length + 1)
+          && isAvailable(info, r, ends[i], starts[j]))
+        available.push_back(j);
+
+    // A temporary costs a Dup and a PopVar
+    if (available.size() * weight(starts[i], ends[i]) <= 2)
+      continue;
+    best = i;
+    found = true;
+    uses = available;
+  }
+  if (!found)
+    return false;
+
+  Atom temp = m_optimizer.temp();
+  CodeEditor::Code def;
+  def.push_back(Instruction(Instruction::Dup));
+  def.push_back(Instruction(Instruction::PopVar, temp));
+  editor.insertAfter(ends[best], def);
+
+  CodeEditor::Code use;
+  use.push_back(Instruction(Instruction::PushVar, temp));
+  for (size_t i=0; i<uses.size(); i++)
+    editor.replace(starts[uses[i]], ends[uses[i]], use);
+  return true;
+}
+
+// Instructions saved by not computing [start, end] again;
+// an array read counts as three
+unsigned int CommonSubexpressionEliminator::weight(size_t start, size_t end) const
+{
+  unsigned int w = end - start;
+  for (size_t addr = start; addr <= end; addr++)
+    if (m_prog[addr].isArrayRead())
+      w += 2;
+  return w;
+}
+
+CommonSubexpressionEliminator::Reads CommonSubexpressionEliminator::reads(
+    const CodeAnalysis &info, size_t start, size_t end) const
+{
+  Reads r;
+  for (size_t addr = start; addr <= end; addr++)
+  {
+    const Instruction &instr = m_prog[addr];
+    if (instr.opcode != Instruction::PushVar && !instr.isArrayRead())
+      continue;
+    if (!contains(r.vars, instr.arg.atom))
+      r.vars.push_back(instr.arg.atom);
+    if (info.isGlobal(instr.arg.atom))
+      r.globals = true;
+    if (instr.isArrayRead())
+      r.arrays = true;
+  }
+  return r;
+}
+
+// Whether anything in [begin, end) may change the value
+bool CommonSubexpressionEliminator::kills(const Reads &reads,
+    size_t begin, size_t end) const
+{
+  for (size_t addr = begin; addr < end; addr++)
+  {
+    const Instruction &instr = m_prog[addr];
+    if (instr.opcode == Instruction::PopVar && contains(reads.vars, instr.arg.atom))
+      return true;
+    if (instr.isArrayWrite() && reads.arrays)
+      return true;
+    if (instr.opcode == Instruction::Call && (reads.arrays || reads.globals))
+      return true;
+  }
+  return false;
+}
+
+bool CommonSubexpressionEliminator::isAvailable(const CodeAnalysis &info,
+    const Reads &reads, size_t defEnd, size_t useStart) const
+{
+  const FlowGraph &graph = info.graph();
+  size_t from = graph.blockOf(defEnd);
+  size_t to = graph.blockOf(useStart);
+
+  // Every path into the defining block computes the value anew
+  if (from == to)
+    return defEnd < useStart && !kills(reads, defEnd+1, useStart);
+  if (!graph.dominates(from, to)
+      || kills(reads, defEnd+1, graph.block(from).end)
+      || kills(reads, graph.block(to).begin, useStart))
+    return false;
+
+  // Blocks on the paths in between: reachable from the defining block
+  // and reaching the using one, without passing the defining block
+  size_t n = graph.blockCount();
+  Vector<bool> forward(n), backward(n);
+  Stack<size_t> work;
+  for (size_t i=0; i<graph.block(from).succs.size(); i++)
+    work.push(graph.block(from).succs[i]);
+  while (!work.empty())
+  {
+    size_t b = work.top();
+    work.pop();
+    if (b == from || forward[b])
+      continue;
+    forward[b] = true;
+    for (size_t i=0; i<graph.block(b).succs.size(); i++)
+      work.push(graph.block(b).succs[i]);
+  }
+  for (size_t i=0; i<graph.block(to).preds.size(); i++)
+    work.push(graph.block(to).preds[i]);
+  while (!work.empty())
+  {
+    size_t b = work.top();
+    work.pop();
+    if (b == from || backward[b])
+      continue;
+    backward[b] = true;
+    for (size_t i=0; i<graph.block(b).preds.size(); i++)
+      work.push(graph.block(b).preds[i]);
+  }
+
+  for (size_t b=0; b<n; b++)
+    if (forward[b] && backward[b] && kills(reads, graph.block(b).begin, graph.block(b).end))
+      return false;
+  return true;
+}
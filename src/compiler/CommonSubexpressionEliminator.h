@@ -0,0 +1,54 @@
+#ifndef COMMONSUBEXPRESSIONELIMINATOR_H
+#define COMMONSUBEXPRESSIONELIMINATOR_H
+
+#include "Program.h"
+#include "FlowGraph.h"
+#include "CodeAnalysis.h"
+#include "CodeEditor.h"
+#include "Optimizer.h"
+
+/**
+ * Common subexpression elimination over the code of one function.
+ *
+ * An expression computed again where its first computation is still
+ * available is replaced by a temporary. The first computation must
+ * dominate the later one, and no path between them may:
+ * - assign a variable the expression reads;
+ * - store to any array, if it reads an array (variables may refer
+ *   to the same array);
+ * - call a function, if it reads an array or a global.
+ *
+ * Only expressions whose reuse pays for keeping the temporary are
+ * taken, largest first.
+ */
+class CommonSubexpressionEliminator
+{
+  public:
+    CommonSubexpressionEliminator(Program &prog, Optimizer &optimizer)
+      : m_prog(prog), m_optimizer(optimizer) {}
+
+    // Optimize the function in [begin, end), returns its new end
+    size_t optimize(size_t begin, size_t end);
+
+  private:
+    // What may change the value of an expression
+    struct Reads
+    {
+      Reads(): arrays(false), globals(false) {}
+      Vector<StringTable::Ref> vars;
+      bool arrays;
+      bool globals;
+    };
+
+    bool eliminateOne(const CodeAnalysis &info, CodeEditor &editor);
+    Reads reads(const CodeAnalysis &info, size_t start, size_t end) const;
+    bool kills(const Reads &reads, size_t begin, size_t end) const;
+    bool isAvailable(const CodeAnalysis &info, const Reads &reads,
+        size_t defEnd, size_t useStart) const;
+    unsigned int weight(size_t start, size_t end) const;
+
+    Program &m_prog;
+    Optimizer &m_optimizer;
+};
+
+#endif // COMMONSUBEXPRESSIONELIMINATOR_H
@@ -13,6 +13,20 @@ void Compiler::compile(Fun *funs)
   }
 }
 
+void Compiler::declare(Fun *funs)
+{
+  for (; funs != NULL; funs = funs->next<Fun>())
+    m_declared.push_back(funs->name());
+}
+
+bool Compiler::declares(const char *name) const
+{
+  for (size_t i=0; i<m_declared.size(); i++)
+    if (m_declared[i] == name)
+      return true;
+  return false;
+}
+
 void Compiler::compileFun(Fun *fun)
 {
   // Define an entry point
@@ -189,14 +203,19 @@ void Compiler::compilePush(Variable *expr)
 
 void Compiler::compilePush(FuncCall *expr)
 {
-  compilePush(expr->arg());
+  // local array N is local N, unless the script defines either itself
+  Expression *arg = expr->arg();
+  if (expr->name() == "local" && arg->type() == Base::FuncCall 
+      && arg->as<FuncCall>()->name() == "array"
+      && !declares("local") && !declares("array"))
+    arg = arg->as<FuncCall>()->arg();
+  compilePush(arg);
   emit(Instruction::Call, expr->name());
 }
 
 void Compiler::compilePush(ArrayItem *expr)
 {
-  compilePush(expr->arg());
-  emit(Instruction::PushArrayItem, expr->name());
+  compileIndex(expr, Instruction::PushArrayItem, Instruction::PushArrayCell);
 }
 
 void Compiler::compilePush(Tuple *expr)
@@ -283,8 +302,28 @@ void Compiler::compilePop(Variable *expr)
 
 void Compiler::compilePop(ArrayItem *expr)
 {
-  compilePush(expr->arg());
-  emit(Instruction::PopArrayItem, expr->name());
+  compileIndex(expr, Instruction::PopArrayItem, Instruction::PopArrayCell);
+}
+
+// $M [I, J] addresses a cell of a multi-dimensional array: the 
+// indices are pushed one by one, and the cell instruction counts them
+void Compiler::compileIndex(ArrayItem *expr, Instruction::Opcode item, 
+    Instruction::Opcode cell)
+{
+  if (expr->arg()->type() != Base::Tuple)
+  {
+    compilePush(expr->arg());
+    emit(item, expr->name());
+    return;
+  }
+  unsigned int rank = 0;
+  for (Expression *e = expr->arg()->as<Tuple>()->contents(); e != NULL; 
+      e = e->next<Expression>())
+  {
+    compilePush(e);
+    rank++;
+  }
+  m_prog.write(Instruction(cell, expr->name(), rank));
 }
 
 void Compiler::compilePop(Tuple *expr)
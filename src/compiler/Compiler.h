@@ -10,10 +10,13 @@ class Compiler
     Compiler(Program &prog)
       : m_prog(prog) {}
 
+    // Functions of the script, all declared before any is compiled
+    void declare(AST::Fun *funs);
     void compile(AST::Fun *funs);
     Program &program() { return m_prog; }
   private:
     void compileFun(AST::Fun *fun);
+    bool declares(const char *name) const;
 
     void compileBlock(AST::Operator *block);
     void compileOperator(AST::Operator *op);
@@ -44,6 +47,8 @@ class Compiler
     void compilePop(AST::Variable *expr);
     void compilePop(AST::ArrayItem *expr);
     void compilePop(AST::Tuple *expr);
+    void compileIndex(AST::ArrayItem *expr, Instruction::Opcode item, 
+        Instruction::Opcode cell);
 
     
     template<class T> 
@@ -51,6 +56,7 @@ class Compiler
     size_t emit(Instruction::Opcode opcode) { return m_prog.write(Instruction(opcode)); }
 
     Program &m_prog; 
+    Vector<Atom> m_declared;
 };
 
 #endif // COMPILER_H
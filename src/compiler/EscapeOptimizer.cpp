@@ -0,0 +1,234 @@
+#include "EscapeOptimizer.h"
+#include "Stack.h"
+
+EscapeOptimizer::EscapeOptimizer(Program &prog, Optimizer &optimizer)
+  : m_prog(prog), m_optimizer(optimizer),
+    m_array(optimizer.builtin("array")),
+    m_size(optimizer.builtin("size")),
+    m_print(optimizer.builtin("print")),
+    m_println(optimizer.builtin("println"))
+{
+}
+
+static bool contains(const Vector<StringTable::Ref> &vars, StringTable::Ref var)
+{
+  for (size_t i=0; i<vars.size(); i++)
+    if (vars[i] == var)
+      return true;
+  return false;
+}
+
+size_t EscapeOptimizer::optimize(size_t begin, size_t end)
+{
+  FlowGraph graph(m_prog, begin, end);
+  CodeAnalysis info(m_prog, graph);
+  CodeEditor editor(m_prog, begin, end);
+
+  Vector<StringTable::Ref> vars;
+  for (size_t addr = begin+1; addr < end; addr++)
+    if (m_prog[addr].opcode == Instruction::PopVar && isCall(m_prog[addr-1], m_array)
+        && !contains(vars, m_prog[addr].arg.atom))
+      vars.push_back(m_prog[addr].arg.atom);
+
+  for (size_t i=0; i<vars.size(); i++)
+  {
+    int size;
+    if (!isCandidate(info, vars[i]))
+      continue;
+    if (scalarSize(info, vars[i], size))
+      replaceByScalars(info, vars[i], size, editor);
+    else
+      allocInFrame(info, vars[i]);
+  }
+  return editor.empty()? end : editor.apply();
+}
+
+bool EscapeOptimizer::isCandidate(const CodeAnalysis &info, StringTable::Ref var) const
+{
+  if (info.isGlobal(var))
+    return false;
+  const FlowGraph &graph = info.graph();
+  for (size_t addr = graph.begin(); addr < graph.end(); addr++)
+  {
+    const Instruction &instr = m_prog[addr];
+    if (instr.arg.atom != var)
+      continue;
+    // Multi-dimensional arrays take their dimensions in a tuple
+    if (instr.opcode == Instruction::PopVar
+        && (graph.isLeader(addr) || !isCall(m_prog[addr-1], m_array)
+          || m_prog[addr-2].opcode == Instruction::TupClose))
+      return false;
+    if (instr.opcode == Instruction::PushVar && escapes(addr))
+      return false;
+  }
+  return true;
+}
+
+// What lies on the stack above a value
+enum StackItem { Plain, Open, Close };
+
+// Whether the value pushed at addr may outlive the frame. Follows
+// the stack up to the instruction consuming the value.
+bool EscapeOptimizer::escapes(size_t addr) const
+{
+  Stack<StackItem> above;
+  for (size_t a = addr+1; a < m_prog.size(); a++)
+  {
+    const Instruction &instr = m_prog[a];
+    switch (instr.opcode)
+    {
+      case Instruction::PushVar:
+      case Instruction::PushInt:
+      case Instruction::PushReal:
+      case Instruction::PushBool:
+      case Instruction::PushString:
+        above.push(Plain);
+        continue;
+      case Instruction::TupOpen:
+        above.push(Open);
+        continue;
+      case Instruction::TupClose:
+        above.push(Close);
+        continue;
+      case Instruction::PushArrayItem:
+      case Instruction::PushArrayItemUnchecked:
+        // Taking the array for an index fails anyway
+        if (above.empty())
+          return false;
+        above.pop();
+        above.push(Plain);
+        continue;
+      case Instruction::GuardArrayRange:
+        return above.size() >= 5;
+      case Instruction::Call:
+        break;
+      default:
+        if ((instr.isBinOp() || instr.isIntOp()) && above.size() >= 2)
+        {
+          above.pop();
+          above.pop();
+          above.push(Plain);
+          continue;
+        }
+        return true;
+    }
+
+    // size takes the value alone, printing takes it alone or in a tuple
+    bool printing = isCall(instr, m_print) || isCall(instr, m_println);
+    if (above.empty())
+      return !printing && !isCall(instr, m_size);
+    if (!printing || above.top() != Close)
+      return true;
+    // The printed tuple must be opened below the value
+    int level = 0;
+    for (size_t i = above.size(); i-- > 0; )
+    {
+      if (above[i] == Close)
+        level++;
+      else if (above[i] == Open)
+        level--;
+      if (level == 0)
+        return true;
+    }
+    return false;
+  }
+  return true;
+}
+
+bool EscapeOptimizer::scalarSize(const CodeAnalysis &info, StringTable::Ref var,
+    int &size) const
+{
+  const FlowGraph &graph = info.graph();
+  bool sized = false;
+  for (size_t addr = graph.begin(); addr < graph.end(); addr++)
+  {
+    const Instruction &instr = m_prog[addr];
+    if (instr.arg.atom != var)
+      continue;
+    if (instr.opcode == Instruction::PopVar)
+    {
+      // [PushInt size][Call array][PopVar var]
+      if (addr < graph.begin() + 2 || graph.isLeader(addr-1) || graph.isLeader(addr))
+        return false;
+      const Instruction &n = m_prog[addr-2];
+      if (n.opcode != Instruction::PushInt || n.arg.intval < 0
+          || n.arg.intval > MaxScalarSize || (sized && n.arg.intval != size))
+        return false;
+      size = n.arg.intval;
+      sized = true;
+    }
+    else if (instr.opcode == Instruction::PushVar)
+    {
+      if (addr+1 >= graph.end() || graph.isLeader(addr+1) || !isCall(m_prog[addr+1], m_size))
+        return false;
+    }
+    else if (instr.isArrayRead() || instr.isArrayWrite())
+    {
+      if (instr.isArrayCell() || graph.isLeader(addr) 
+          || m_prog[addr-1].opcode != Instruction::PushInt)
+        return false;
+    }
+  }
+  if (!sized)
+    return false;
+
+  // Every index in range
+  for (size_t addr = graph.begin(); addr < graph.end(); addr++)
+  {
+    const Instruction &instr = m_prog[addr];
+    if (instr.arg.atom == var && (instr.isArrayRead() || instr.isArrayWrite())
+        && (m_prog[addr-1].arg.intval < 1 || m_prog[addr-1].arg.intval > size))
+      return false;
+  }
+  return true;
+}
+
+void EscapeOptimizer::replaceByScalars(const CodeAnalysis &info, StringTable::Ref var,
+    int size, CodeEditor &editor)
+{
+  Vector<Atom> items;
+  for (int i=0; i<size; i++)
+    items.push_back(m_optimizer.temp());
+
+  const FlowGraph &graph = info.graph();
+  for (size_t addr = graph.begin(); addr < graph.end(); addr++)
+  {
+    const Instruction &instr = m_prog[addr];
+    if (instr.arg.atom != var)
+      continue;
+    CodeEditor::Code code;
+    if (instr.opcode == Instruction::PopVar)
+    {
+      // Fresh items are Int zeroes, as in a new array
+      for (int i=0; i<size; i++)
+      {
+        code.push_back(Instruction(Instruction::PushInt, 0));
+        code.push_back(Instruction(Instruction::PopVar, items[i]));
+      }
+      editor.replace(addr-2, addr, code);
+      m_optimizer.stats().scalarArrays++;
+    }
+    else if (instr.opcode == Instruction::PushVar)
+    {
+      code.push_back(Instruction(Instruction::PushInt, size));
+      editor.replace(addr, addr+1, code);
+    }
+    else if (instr.isArrayRead() || instr.isArrayWrite())
+    {
+      code.push_back(Instruction(instr.isArrayRead()? Instruction::PushVar : Instruction::PopVar,
+            items[m_prog[addr-1].arg.intval - 1]));
+      editor.replace(addr-1, addr, code);
+    }
+  }
+}
+
+void EscapeOptimizer::allocInFrame(const CodeAnalysis &info, StringTable::Ref var)
+{
+  const FlowGraph &graph = info.graph();
+  for (size_t addr = graph.begin(); addr < graph.end(); addr++)
+    if (m_prog[addr].opcode == Instruction::PopVar && m_prog[addr].arg.atom == var)
+    {
+      m_prog[addr-1] = Instruction(Instruction::AllocFrameArray);
+      m_optimizer.stats().frameArrays++;
+    }
+}
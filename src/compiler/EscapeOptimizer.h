@@ -0,0 +1,52 @@
+#ifndef ESCAPEOPTIMIZER_H
+#define ESCAPEOPTIMIZER_H
+
+#include "Program.h"
+#include "FlowGraph.h"
+#include "CodeAnalysis.h"
+#include "CodeEditor.h"
+#include "Optimizer.h"
+
+/**
+ * Escape analysis of the arrays of one function.
+ *
+ * An array held by a local variable does not escape when the variable
+ * is only assigned fresh arrays, and its value is only used for item
+ * access, by size, print and println, and by bounds-check guards.
+ * Such an array:
+ * - is scalar-replaced by locals when it is small, allocated with a
+ *   constant size and indexed by constants only;
+ * - or else is owned by the function's frame, and released on return
+ *   (AllocFrameArray).
+ */
+class EscapeOptimizer
+{
+  public:
+    // Largest array to scalar-replace
+    static const int MaxScalarSize = 8;
+
+    EscapeOptimizer(Program &prog, Optimizer &optimizer);
+
+    // Optimize the function in [begin, end), returns its new end
+    size_t optimize(size_t begin, size_t end);
+
+  private:
+    bool isCandidate(const CodeAnalysis &info, StringTable::Ref var) const;
+    bool escapes(size_t addr) const;
+    bool scalarSize(const CodeAnalysis &info, StringTable::Ref var, int &size) const;
+    void replaceByScalars(const CodeAnalysis &info, StringTable::Ref var, int size,
+        CodeEditor &editor);
+    void allocInFrame(const CodeAnalysis &info, StringTable::Ref var);
+
+    bool isCall(const Instruction &instr, StringTable::Ref name) const
+      { return instr.opcode == Instruction::Call && instr.arg.atom == name; }
+
+    Program &m_prog;
+    Optimizer &m_optimizer;
+    StringTable::Ref m_array;
+    StringTable::Ref m_size;
+    StringTable::Ref m_print;
+    StringTable::Ref m_println;
+};
+
+#endif // ESCAPEOPTIMIZER_H
@@ -0,0 +1,290 @@
+#include "FlowGraph.h"
+#include "Stack.h"
+
+FlowGraph::FlowGraph(const Program &prog, size_t begin, size_t end)
+  : m_prog(prog), m_begin(begin), m_end(end)
+{
+  buildBlocks();
+  buildDominators();
+  buildLoops();
+}
+
+static bool endsBlock(const Instruction &instr)
+{
+  switch (instr.opcode)
+  {
+    case Instruction::Jump:
+    case Instruction::JumpIfNot:
+    case Instruction::Return:
+    case Instruction::Trap:
+      return true;
+    default:
+      return false;
+  }
+}
+
+void FlowGraph::buildBlocks()
+{
+  size_t n = m_end - m_begin;
+  Vector<bool> leader(n);
+  if (n > 0)
+    leader[0] = true;
+  for (size_t addr = m_begin; addr < m_end; addr++)
+  {
+    const Instruction &instr = m_prog[addr];
+    if (instr.opcode == Instruction::Jump || instr.opcode == Instruction::JumpIfNot)
+    {
+      if (instr.arg.addr >= m_begin && instr.arg.addr < m_end)
+        leader[instr.arg.addr - m_begin] = true;
+    }
+    if (endsBlock(instr) && addr+1 < m_end)
+      leader[addr+1 - m_begin] = true;
+  }
+
+  // Split into blocks
+  m_blockOf.resize(n);
+  for (size_t i=0; i<n; i++)
+  {
+    if (leader[i])
+      m_blocks.push_back(Block(m_begin+i, m_begin+i));
+    m_blocks[m_blocks.size()-1].end = m_begin+i+1;
+    m_blockOf[i] = m_blocks.size()-1;
+  }
+
+  // Connect blocks
+  for (size_t b=0; b<m_blocks.size(); b++)
+  {
+    const Instruction &last = m_prog[m_blocks[b].end-1];
+    bool fallthrough = true;
+    switch (last.opcode)
+    {
+      case Instruction::Jump:
+        fallthrough = false;
+        // fall through
+      case Instruction::JumpIfNot:
+        if (last.arg.addr >= m_begin && last.arg.addr < m_end)
+          m_blocks[b].succs.push_back(blockOf(last.arg.addr));
+        break;
+      case Instruction::Return:
+      case Instruction::Trap:
+        fallthrough = false;
+        break;
+      default:
+        break;
+    }
+    if (fallthrough && b+1 < m_blocks.size())
+      m_blocks[b].succs.push_back(b+1);
+  }
+  for (size_t b=0; b<m_blocks.size(); b++)
+    for (size_t i=0; i<m_blocks[b].succs.size(); i++)
+      m_blocks[m_blocks[b].succs[i]].preds.push_back(b);
+}
+
+void FlowGraph::buildDominators()
+{
+  size_t n = m_blocks.size();
+  m_reachable.resize(n);
+  if (n == 0)
+    return;
+
+  // Depth-first postorder from the entry block
+  Vector<size_t> postorder;
+  Vector<size_t> nextSucc(n);
+  Stack<size_t> path;
+  path.push(0);
+  m_reachable[0] = true;
+  while (!path.empty())
+  {
+    size_t b = path.top();
+    if (nextSucc[b] < m_blocks[b].succs.size())
+    {
+      size_t s = m_blocks[b].succs[nextSucc[b]++];
+      if (!m_reachable[s])
+      {
+        m_reachable[s] = true;
+        path.push(s);
+      }
+    }
+    else
+    {
+      postorder.push_back(b);
+      path.pop();
+    }
+  }
+
+  Vector<size_t> rpoIndex(n);
+  for (size_t i=0; i<postorder.size(); i++)
+  {
+    size_t b = postorder[postorder.size()-1-i];
+    m_rpo.push_back(b);
+    rpoIndex[b] = i;
+  }
+
+  // Cooper, Harvey, Kennedy: "A Simple, Fast Dominance Algorithm"
+  Vector<bool> done(n);
+  m_blocks[0].idom = 0;
+  done[0] = true;
+  bool changed = true;
+  while (changed)
+  {
+    changed = false;
+    for (size_t i=1; i<m_rpo.size(); i++)
+    {
+      Block &block = m_blocks[m_rpo[i]];
+      bool found = false;
+      size_t idom = 0;
+      for (size_t p=0; p<block.preds.size(); p++)
+      {
+        size_t pred = block.preds[p];
+        if (!done[pred])
+          continue;
+        if (!found)
+        {
+          idom = pred;
+          found = true;
+          continue;
+        }
+        // Intersect
+        size_t a = pred, b = idom;
+        while (a != b)
+        {
+          while (rpoIndex[a] > rpoIndex[b])
+            a = m_blocks[a].idom;
+          while (rpoIndex[b] > rpoIndex[a])
+            b = m_blocks[b].idom;
+        }
+        idom = a;
+      }
+      if (found && (!done[m_rpo[i]] || block.idom != idom))
+      {
+        block.idom = idom;
+        done[m_rpo[i]] = true;
+        changed = true;
+      }
+    }
+  }
+}
+
+bool FlowGraph::dominates(size_t a, size_t b) const
+{
+  if (!m_reachable[a] || !m_reachable[b])
+    return false;
+  while (b != a && b != 0)
+    b = m_blocks[b].idom;
+  return b == a;
+}
+
+void FlowGraph::buildLoops()
+{
+  for (size_t i=0; i<m_rpo.size(); i++)
+  {
+    size_t b = m_rpo[i];
+    for (size_t s=0; s<m_blocks[b].succs.size(); s++)
+      if (dominates(m_blocks[b].succs[s], b))
+        addLoop(m_blocks[b].succs[s], b);
+  }
+
+  for (size_t l=0; l<m_loops.size(); l++)
+  {
+    Loop &loop = m_loops[l];
+    Vector<bool> member(m_blocks.size());
+    for (size_t i=0; i<loop.blocks.size(); i++)
+      member[loop.blocks[i]] = true;
+
+    loop.first = m_end;
+    loop.last = m_begin;
+    for (size_t i=0; i<loop.blocks.size(); i++)
+    {
+      const Block &block = m_blocks[loop.blocks[i]];
+      if (block.begin < loop.first)
+        loop.first = block.begin;
+      if (block.end-1 > loop.last)
+        loop.last = block.end-1;
+      for (size_t s=0; s<block.succs.size(); s++)
+        if (!member[block.succs[s]])
+        {
+          loop.exits.push_back(loop.blocks[i]);
+          break;
+        }
+    }
+  }
+
+  // Inner loops first: an inner loop has fewer blocks than any outer one
+  for (size_t i=0; i<m_loops.size(); i++)
+    for (size_t j=i+1; j<m_loops.size(); j++)
+      if (m_loops[j].blocks.size() < m_loops[i].blocks.size())
+      {
+        Loop tmp = m_loops[i];
+        m_loops[i] = m_loops[j];
+        m_loops[j] = tmp;
+      }
+}
+
+void FlowGraph::addLoop(size_t header, size_t latch)
+{
+  Loop *loop = NULL;
+  for (size_t i=0; i<m_loops.size(); i++)
+    if (m_loops[i].header == header)
+      loop = &m_loops[i];
+  if (loop == NULL)
+  {
+    m_loops.push_back(Loop(header));
+    loop = &m_loops[m_loops.size()-1];
+    loop->blocks.push_back(header);
+  }
+
+  Vector<bool> member(m_blocks.size());
+  for (size_t i=0; i<loop->blocks.size(); i++)
+    member[loop->blocks[i]] = true;
+
+  // Everything reaching the latch without passing the header
+  Stack<size_t> work;
+  if (!member[latch])
+  {
+    member[latch] = true;
+    loop->blocks.push_back(latch);
+    work.push(latch);
+  }
+  while (!work.empty())
+  {
+    size_t b = work.top();
+    work.pop();
+    for (size_t p=0; p<m_blocks[b].preds.size(); p++)
+    {
+      size_t pred = m_blocks[b].preds[p];
+      if (!member[pred] && m_reachable[pred])
+      {
+        member[pred] = true;
+        loop->blocks.push_back(pred);
+        work.push(pred);
+      }
+    }
+  }
+}
+
+bool FlowGraph::inLoop(const Loop &loop, size_t addr) const
+{
+  if (addr < m_begin || addr >= m_end)
+    return false;
+  size_t b = blockOf(addr);
+  for (size_t i=0; i<loop.blocks.size(); i++)
+    if (loop.blocks[i] == b)
+      return true;
+  return false;
+}
+
+bool FlowGraph::hasPreheaderSlot(const Loop &loop) const
+{
+  const Block &header = m_blocks[loop.header];
+  if (header.begin != loop.first || header.begin == m_begin)
+    return false;
+  // The preheader is entered by every jump to the header, except 
+  // for the ones from [first, last]
+  for (size_t i=0; i<header.preds.size(); i++)
+  {
+    const Block &pred = m_blocks[header.preds[i]];
+    if (pred.begin >= loop.first && pred.begin <= loop.last && !inLoop(loop, pred.begin))
+      return false;
+  }
+  return true;
+}
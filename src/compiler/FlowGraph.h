@@ -0,0 +1,73 @@
+#ifndef FLOWGRAPH_H
+#define FLOWGRAPH_H
+
+#include "Vector.h"
+#include "Program.h"
+
+/**
+ * A control flow graph of one function's linear code.
+ *
+ * Basic blocks, dominators and natural loops are recovered from
+ * the Jump/JumpIfNot structure of the code in [begin, end).
+ */
+class FlowGraph
+{
+  public:
+    struct Block
+    {
+      Block(size_t b=0, size_t e=0)
+        : begin(b), end(e), idom(0) {}
+      size_t begin; // First instruction
+      size_t end;   // Past the last instruction
+      Vector<size_t> succs;
+      Vector<size_t> preds;
+      size_t idom;  // Immediate dominator (entry block: itself)
+    };
+
+    struct Loop
+    {
+      Loop(size_t h=0)
+        : header(h), first(0), last(0) {}
+      size_t header;         // Header block
+      Vector<size_t> blocks; // Member blocks, header included
+      Vector<size_t> exits;  // Member blocks with successors outside
+      size_t first;          // Lowest member address
+      size_t last;           // Highest member address
+    };
+
+    FlowGraph(const Program &prog, size_t begin, size_t end);
+
+    size_t begin() const { return m_begin; }
+    size_t end() const { return m_end; }
+
+    size_t blockCount() const { return m_blocks.size(); }
+    const Block &block(size_t i) const { return m_blocks[i]; }
+    size_t blockOf(size_t addr) const { return m_blockOf[addr - m_begin]; }
+    bool isLeader(size_t addr) const { return m_blocks[blockOf(addr)].begin == addr; }
+    bool isReachable(size_t b) const { return m_reachable[b]; }
+    bool dominates(size_t a, size_t b) const;
+
+    // Loops are ordered inner first
+    size_t loopCount() const { return m_loops.size(); }
+    const Loop &loop(size_t i) const { return m_loops[i]; }
+    bool inLoop(const Loop &loop, size_t addr) const;
+    // Whether CodeEditor::insertPreheader can give the loop a preheader
+    bool hasPreheaderSlot(const Loop &loop) const;
+
+  private:
+    void buildBlocks();
+    void buildDominators();
+    void buildLoops();
+    void addLoop(size_t header, size_t latch);
+
+    const Program &m_prog;
+    size_t m_begin;
+    size_t m_end;
+    Vector<Block> m_blocks;
+    Vector<size_t> m_blockOf;
+    Vector<bool> m_reachable;
+    Vector<size_t> m_rpo;
+    Vector<Loop> m_loops;
+};
+
+#endif // FLOWGRAPH_H
@@ -80,30 +80,30 @@ Base *LexemGenerator::make(const char *str, bool isLiteral, const TextRegion &re
 {
   // Literal
   if (isLiteral)
-    return new Literal(atom(str), region);
+    return new (m_arena) Literal(atom(str), region);
 
   // Symbol
   Symbols::Ref sym = Symbols::find(str);
   if (sym.isValid())
   {
     if (sym.type() > Symbol::InfixBegin && sym.type() < Symbol::InfixEnd)
-      return new Infix(infixType(sym.type()), NULL, NULL, region);
+      return new (m_arena) Infix(infixType(sym.type()), NULL, NULL, region);
     else
-      return new Symbol(sym.type(), region);
+      return new (m_arena) Symbol(sym.type(), region);
   }
 
   // Boolean
   if (strcmp(str, "true") == 0)
-    return new Bool(true, region);
+    return new (m_arena) Bool(true, region);
   if (strcmp(str, "false") == 0)
-    return new Bool(false, region);
+    return new (m_arena) Bool(false, region);
 
   // Function name
   if (islower(str[0]))
   {
     if (!validateIdentifier(str))
       throw Exception("Invalid function name", str, region);
-    return new FuncCall(atom(str), NULL, region);
+    return new (m_arena) FuncCall(atom(str), NULL, region);
   }
 
   // Variable name
@@ -111,7 +111,7 @@ Base *LexemGenerator::make(const char *str, bool isLiteral, const TextRegion &re
   {
     if (!validateIdentifier(str))
       throw Exception("Invalid variable name", str, region);
-    return new Variable(atom(str), region);
+    return new (m_arena) Variable(atom(str), region);
   }
 
   // Array name
@@ -120,7 +120,7 @@ Base *LexemGenerator::make(const char *str, bool isLiteral, const TextRegion &re
     const char *name = str+1; // Remove leading $
     if (!validateIdentifier(name))
       throw Exception("Invalid array name", str, region);
-    return new ArrayItem(atom(name), NULL, region);
+    return new (m_arena) ArrayItem(atom(name), NULL, region);
   }
 
   // Real
@@ -129,12 +129,12 @@ Base *LexemGenerator::make(const char *str, bool isLiteral, const TextRegion &re
     double d;
     if (!validateReal(str, d))
       throw Exception("Invalid real number", str, region);
-    return new Real(d, region);
+    return new (m_arena) Real(d, region);
   }
 
   // Only integer possible here
   int i;
   if (!validateInt(str, i))
     throw Exception("Invalid integer number", str, region);
-  return new Int(i, region);
+  return new (m_arena) Int(i, region);
 }
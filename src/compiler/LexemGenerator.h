@@ -4,6 +4,7 @@
 #include "String.h"
 #include "AST.h"
 #include "ListBuilder.h"
+#include "Arena.h"
 
 class LexemGenerator
 {
@@ -25,8 +26,9 @@ class LexemGenerator
         TextRegion m_region;
     };
 
-    LexemGenerator(StringTable *table)
-      : m_stringtable(table) {}
+    // Lexems are placed in arena
+    LexemGenerator(StringTable *table, Arena &arena)
+      : m_stringtable(table), m_arena(arena) {}
 
     AST::Base *make(const char *str, bool isLiteral, const TextRegion &region);
 
@@ -34,6 +36,7 @@ class LexemGenerator
     Atom atom(const char *str) { return Atom(str, m_stringtable); }
 
     StringTable *m_stringtable;
+    Arena &m_arena;
 };
 
 #endif // LEXEMGENERATOR_H
@@ -18,6 +18,7 @@ AST::Base *Lexer::getNext()
     }
     else
       feed(c);
+    m_chars++;
   }
   return m_tokens.takeFirst();
 }
@@ -176,6 +177,7 @@ void Lexer::endToken(int row, int col)
   m_region.endRow = row;
   m_region.endCol = col;
   m_tokens.add(m_lexgen.make(m_current_token.c_str(), m_is_literal, m_region));
+  m_tokens_made++;
   m_current_token.clear();
   m_is_literal = false; 
 }
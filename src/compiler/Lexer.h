@@ -26,13 +26,19 @@ class Lexer: public DataSource<AST::Base *>
         const char *m_text;
     };
 
-    Lexer(DataSource<int> *source, StringTable *table)
+    // Lexems are placed in arena
+    Lexer(DataSource<int> *source, StringTable *table, Arena &arena)
       : m_state(S_Whitespace), m_is_literal(false), 
-        m_row(0), m_col(0), m_source(source), m_lexgen(table) {}
+        m_row(0), m_col(0), m_chars(0), m_tokens_made(0),
+        m_source(source), m_lexgen(table, arena) {}
     
     // Reimplemented from DataSource<AST::Base *>
     virtual AST::Base *getNext();
 
+    // Input read and lexems made so far
+    size_t charCount() const { return m_chars; }
+    size_t tokenCount() const { return m_tokens_made; }
+
   private:
     enum State
     {
@@ -63,6 +69,8 @@ class Lexer: public DataSource<AST::Base *>
     TextRegion m_region;
     unsigned int m_row;
     unsigned int m_col;
+    size_t m_chars;
+    size_t m_tokens_made;
 
     DataSource<int> *m_source;
     LexemGenerator m_lexgen;
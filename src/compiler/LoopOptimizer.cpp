@@ -0,0 +1,395 @@
+#include "LoopOptimizer.h"
+
+size_t LoopOptimizer::optimize(size_t begin, size_t end)
+{
+  end = reduceDivisions(begin, end);
+
+  // Rewriting never changes the block structure, so loops keep their
+  // order between rebuilds of the graph
+  for (size_t l=0; ; l++)
+  {
+    FlowGraph graph(m_prog, begin, end);
+    if (l >= graph.loopCount())
+      break;
+    CodeAnalysis info(m_prog, graph);
+    CodeEditor editor(m_prog, begin, end);
+    optimizeLoop(info, graph.loop(l), editor);
+    if (!editor.empty())
+      end = editor.apply();
+  }
+  return end;
+}
+
+static bool contains(const Vector<StringTable::Ref> &vars, StringTable::Ref var)
+{
+  for (size_t i=0; i<vars.size(); i++)
+    if (vars[i] == var)
+      return true;
+  return false;
+}
+
+static bool hasSideEffect(const Instruction &instr)
+{
+  return instr.opcode == Instruction::Call 
+      || instr.isArrayWrite();
+}
+
+// ========= Division by powers of two
+
+size_t LoopOptimizer::reduceDivisions(size_t begin, size_t end)
+{
+  FlowGraph graph(m_prog, begin, end);
+  CodeAnalysis info(m_prog, graph);
+  CodeEditor editor(m_prog, begin, end);
+
+  for (size_t addr = begin+1; addr < end; addr++)
+  {
+    Instruction::Opcode op = Instruction::genericVariant(m_prog[addr].opcode);
+    const Instruction &divisor = m_prog[addr-1];
+    if ((op != Instruction::Div && op != Instruction::Mod)
+        || divisor.opcode != Instruction::PushInt
+        || graph.isLeader(addr))
+      continue;
+
+    int d = divisor.arg.intval;
+    int shift = 0;
+    while (shift < 30 && (1 << shift) < d)
+      shift++;
+    if (d < 2 || (1 << shift) != d)
+      continue;
+
+    // x / 2^k == x >> k and x % 2^k == x & (2^k-1) for x >= 0 only
+    size_t start;
+    if (!info.operandStart(addr-1, start) || !info.isNonNegative(start, addr-2))
+      continue;
+
+    CodeEditor::Code code;
+    if (op == Instruction::Div)
+    {
+      code.push_back(Instruction(Instruction::PushInt, shift));
+      code.push_back(Instruction(Instruction::ShiftRight));
+    }
+    else
+    {
+      code.push_back(Instruction(Instruction::PushInt, d-1));
+      code.push_back(Instruction(Instruction::BitAnd));
+    }
+    editor.replace(addr-1, addr, code);
+  }
+  return editor.empty()? end : editor.apply();
+}
+
+// ========= Loops
+
+void LoopOptimizer::optimizeLoop(const CodeAnalysis &info, 
+    const FlowGraph::Loop &loop, CodeEditor &editor)
+{
+  const FlowGraph &graph = info.graph();
+  if (!graph.hasPreheaderSlot(loop))
+    return;
+
+  LoopFacts facts;
+  for (size_t addr = loop.first; addr <= loop.last; addr++)
+  {
+    const Instruction &instr = m_prog[addr];
+    if (instr.opcode == Instruction::PopVar && !contains(facts.written, instr.arg.atom))
+      facts.written.push_back(instr.arg.atom);
+    else if (instr.opcode == Instruction::Call)
+      facts.hasCall = true;
+    else if (instr.isArrayWrite())
+      facts.hasStore = true;
+  }
+
+  CodeEditor::Code preheader;
+  hoistInvariants(info, loop, facts, editor, preheader);
+  reduceInductions(info, loop, facts, editor, preheader);
+  if (!preheader.empty())
+    editor.insertPreheader(loop.first, loop.last, preheader);
+}
+
+bool LoopOptimizer::isInvariant(const CodeAnalysis &info, const LoopFacts &facts,
+    size_t start, size_t end) const
+{
+  for (size_t addr = start; addr <= end; addr++)
+  {
+    const Instruction &instr = m_prog[addr];
+    if (instr.opcode != Instruction::PushVar && !instr.isArrayRead())
+      continue;
+    StringTable::Ref var = instr.arg.atom;
+    if (contains(facts.written, var))
+      return false;
+    // Callees may assign globals and store to any array
+    if (info.isGlobal(var) && facts.hasCall)
+      return false;
+    if (instr.isArrayRead() && (facts.hasCall || facts.hasStore))
+      return false;
+  }
+  return true;
+}
+
+// Whether the instruction at addr runs on every pass through the loop,
+// before anything observable happens in it
+bool LoopOptimizer::executesFirst(const CodeAnalysis &info, 
+    const FlowGraph::Loop &loop, size_t addr) const
+{
+  const FlowGraph &graph = info.graph();
+  size_t b = graph.blockOf(addr);
+  for (size_t i=0; i<loop.exits.size(); i++)
+    if (!graph.dominates(b, loop.exits[i]))
+      return false;
+
+  for (size_t i=0; i<loop.blocks.size(); i++)
+  {
+    const FlowGraph::Block &block = graph.block(loop.blocks[i]);
+    if (loop.blocks[i] == b || !graph.dominates(loop.blocks[i], b))
+      continue;
+    for (size_t a = block.begin; a < block.end; a++)
+      if (hasSideEffect(m_prog[a]))
+        return false;
+  }
+  for (size_t a = graph.block(b).begin; a < addr; a++)
+    if (hasSideEffect(m_prog[a]))
+      return false;
+  return true;
+}
+
+// Invariant variables compared by order at the start of the header: 
+// if the loop runs at all, they hold numbers. Arithmetic proves less, 
+// as it takes arrays too.
+CodeAnalysis::VarList LoopOptimizer::checkedNumeric(const CodeAnalysis &info, 
+    const FlowGraph::Loop &loop, const LoopFacts &facts) const
+{
+  CodeAnalysis::VarList numeric;
+  const FlowGraph::Block &header = info.graph().block(loop.header);
+  for (size_t addr = header.begin; addr < header.end; addr++)
+  {
+    const Instruction &instr = m_prog[addr];
+    if (hasSideEffect(instr))
+      break;
+    Instruction::Opcode op = Instruction::genericVariant(instr.opcode);
+    if (op != Instruction::TestLess && op != Instruction::TestGreater && op != Instruction::TestLessEqual
+        && op != Instruction::TestGreaterEqual)
+      continue;
+
+    size_t right, left;
+    if (!info.operandStart(addr, right) || !info.operandStart(right, left))
+      continue;
+    const Instruction *operands[] = { &m_prog[left], &m_prog[right] };
+    bool single[] = { right - left == 1, addr - right == 1 };
+    for (int i=0; i<2; i++)
+      if (single[i] && operands[i]->opcode == Instruction::PushVar
+          && !contains(facts.written, operands[i]->arg.atom)
+          && !(info.isGlobal(operands[i]->arg.atom) && facts.hasCall))
+        numeric.push_back(operands[i]->arg.atom);
+  }
+  return numeric;
+}
+
+void LoopOptimizer::hoistInvariants(const CodeAnalysis &info, 
+    const FlowGraph::Loop &loop, const LoopFacts &facts, 
+    CodeEditor &editor, CodeEditor::Code &preheader)
+{
+  // Maximal invariant expressions. Spans are nested or disjoint, and
+  // an enclosing span ends after the spans inside it.
+  Vector<size_t> starts, ends;
+  for (size_t addr = loop.first; addr <= loop.last; addr++)
+  {
+    size_t start;
+    if (CodeAnalysis::operandCount(m_prog[addr]) == 0
+        || !info.exprStart(addr, start)
+        || !isInvariant(info, facts, start, addr))
+      continue;
+    while (!starts.empty() && starts[starts.size()-1] >= start)
+    {
+      starts.pop_back();
+      ends.pop_back();
+    }
+    starts.push_back(start);
+    ends.push_back(addr);
+  }
+
+  size_t header = info.graph().block(loop.header).begin;
+  CodeAnalysis::VarList numeric = checkedNumeric(info, loop, facts);
+  Vector<size_t> hoisted;  // Index of the first identical span
+  Vector<Atom> temps;
+  for (size_t i=0; i<starts.size(); i++)
+  {
+    size_t start = starts[i], end = ends[i];
+
+    // Moving ahead of the loop must not introduce failures
+    bool speculative = info.mayTrap(start, end, numeric);
+    for (size_t addr = start; addr <= end; addr++)
+    {
+      const Instruction &instr = m_prog[addr];
+      if ((instr.opcode == Instruction::PushVar || instr.isArrayRead())
+          && !info.assignedBefore(instr.arg.atom, header))
+        speculative = true;
+    }
+    if (speculative && !executesFirst(info, loop, start))
+      continue;
+    // Each iteration needs an array of its own
+    if (info.mayMakeArray(start, end, numeric))
+      continue;
+
+    // A temporary computed once (by an inner preheader) moves out whole
+    const Instruction &next = m_prog[end+1];
+    if (next.opcode == Instruction::PopVar && m_optimizer.isTemp(next.arg.atom)
+        && !info.graph().isLeader(end+1))
+    {
+      unsigned int defs = 0;
+      for (size_t addr = loop.first; addr <= loop.last; addr++)
+        if (m_prog[addr].opcode == Instruction::PopVar 
+            && m_prog[addr].arg.atom == next.arg.atom)
+          defs++;
+      if (defs == 1)
+      {
+        for (size_t addr = start; addr <= end+1; addr++)
+          preheader.push_back(m_prog[addr]);
+        editor.replace(start, end+1, CodeEditor::Code());
+        continue;
+      }
+    }
+
+    Atom temp;
+    bool found = false;
+    for (size_t j=0; j<hoisted.size() && !found; j++)
+    {
+      size_t other = hoisted[j];
+      if (ends[other] - starts[other] == end - start
+          && info.sameExpr(starts[other], start, end - start + 1))
+      {
+        temp = temps[j];
+        found = true;
+      }
+    }
+    if (!found)
+    {
+      temp = m_optimizer.temp();
+      for (size_t addr = start; addr <= end; addr++)
+        preheader.push_back(m_prog[addr]);
+      preheader.push_back(Instruction(Instruction::PopVar, temp));
+      hoisted.push_back(i);
+      temps.push_back(temp);
+    }
+
+    CodeEditor::Code use;
+    use.push_back(Instruction(Instruction::PushVar, temp));
+    editor.replace(start, end, use);
+  }
+}
+
+// Matches [PushVar var][PushInt c][op] or [PushInt c][PushVar var][op]
+static bool matchVarConst(const Program &prog, size_t start, 
+    Instruction::Opcode op, StringTable::Ref &var, int &c)
+{
+  const Instruction &a = prog[start];
+  const Instruction &b = prog[start+1];
+  if (Instruction::genericVariant(prog[start+2].opcode) != op)
+    return false;
+  if (a.opcode == Instruction::PushVar && b.opcode == Instruction::PushInt)
+  {
+    var = a.arg.atom;
+    c = b.arg.intval;
+    return true;
+  }
+  if (a.opcode == Instruction::PushInt && b.opcode == Instruction::PushVar
+      && op != Instruction::Sub)
+  {
+    var = b.arg.atom;
+    c = a.arg.intval;
+    return true;
+  }
+  return false;
+}
+
+void LoopOptimizer::reduceInductions(const CodeAnalysis &info, 
+    const FlowGraph::Loop &loop, const LoopFacts &facts, 
+    CodeEditor &editor, CodeEditor::Code &preheader)
+{
+  size_t header = info.graph().block(loop.header).begin;
+  for (size_t v=0; v<facts.written.size(); v++)
+  {
+    StringTable::Ref var = facts.written[v];
+    if (info.isGlobal(var) || info.varTypes(var) != CodeAnalysis::IntType
+        || !info.assignedBefore(var, header))
+      continue;
+
+    // A basic induction variable: the only assignment is var = var +- step
+    size_t def = 0;
+    unsigned int defs = 0;
+    for (size_t addr = loop.first; addr <= loop.last; addr++)
+      if (m_prog[addr].opcode == Instruction::PopVar && m_prog[addr].arg.atom == var)
+      {
+        def = addr;
+        defs++;
+      }
+    size_t start;
+    StringTable::Ref stepVar;
+    int step;
+    if (defs != 1 || !info.operandStart(def, start) || def - start != 3)
+      continue;
+    if (matchVarConst(m_prog, start, Instruction::Add, stepVar, step))
+      ;
+    else if (matchVarConst(m_prog, start, Instruction::Sub, stepVar, step))
+      step = -step;
+    else
+      continue;
+    if (stepVar != var)
+      continue;
+
+    // Products var*k, by factor. A single product per iteration costs
+    // as much as the update replacing it, so only repeated ones pay off.
+    Vector<int> factors;
+    Vector<unsigned int> counts;
+    for (size_t addr = loop.first; addr+2 <= loop.last; addr++)
+    {
+      StringTable::Ref mulVar;
+      int k;
+      if (!info.exprStart(addr+2, start) || start != addr
+          || !matchVarConst(m_prog, addr, Instruction::Mul, mulVar, k) 
+          || mulVar != var)
+        continue;
+      size_t f = 0;
+      while (f < factors.size() && factors[f] != k)
+        f++;
+      if (f == factors.size())
+      {
+        factors.push_back(k);
+        counts.push_back(0);
+      }
+      counts[f]++;
+    }
+
+    for (size_t f=0; f<factors.size(); f++)
+    {
+      if (counts[f] < 2)
+        continue;
+      int k = factors[f];
+      Atom temp = m_optimizer.temp();
+
+      preheader.push_back(Instruction(Instruction::PushVar, Atom(var)));
+      preheader.push_back(Instruction(Instruction::PushInt, k));
+      preheader.push_back(Instruction(Instruction::Mul));
+      preheader.push_back(Instruction(Instruction::PopVar, temp));
+
+      CodeEditor::Code update;
+      update.push_back(Instruction(Instruction::PushVar, temp));
+      update.push_back(Instruction(Instruction::PushInt, k*step));
+      update.push_back(Instruction(Instruction::Add));
+      update.push_back(Instruction(Instruction::PopVar, temp));
+      editor.insertAfter(def, update);
+
+      CodeEditor::Code use;
+      use.push_back(Instruction(Instruction::PushVar, temp));
+      for (size_t addr = loop.first; addr+2 <= loop.last; addr++)
+      {
+        StringTable::Ref mulVar;
+        int factor;
+        if (info.exprStart(addr+2, start) && start == addr
+            && matchVarConst(m_prog, addr, Instruction::Mul, mulVar, factor) 
+            && mulVar == var && factor == k)
+          editor.replace(addr, addr+2, use);
+      }
+    }
+  }
+}
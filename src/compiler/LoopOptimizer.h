@@ -0,0 +1,59 @@
+#ifndef LOOPOPTIMIZER_H
+#define LOOPOPTIMIZER_H
+
+#include "Program.h"
+#include "FlowGraph.h"
+#include "CodeAnalysis.h"
+#include "CodeEditor.h"
+#include "Optimizer.h"
+
+/**
+ * Loop optimizations over the code of one function.
+ *
+ * - Loop-invariant expressions are computed once, in a preheader.
+ * - Products of an induction variable by a constant, used more than 
+ *   once in a loop, become a variable stepped along with it.
+ * - Divisions and remainders of non-negative Ints by powers of two
+ *   become shifts and masks.
+ *
+ * Natural loops are taken from the FlowGraph; only loops whose header
+ * is their lowest address get a preheader.
+ */
+class LoopOptimizer
+{
+  public:
+    LoopOptimizer(Program &prog, Optimizer &optimizer)
+      : m_prog(prog), m_optimizer(optimizer) {}
+
+    // Optimize the function in [begin, end), returns its new end
+    size_t optimize(size_t begin, size_t end);
+
+  private:
+    struct LoopFacts
+    {
+      LoopFacts(): hasCall(false), hasStore(false) {}
+      Vector<StringTable::Ref> written;
+      bool hasCall;
+      bool hasStore;
+    };
+
+    size_t reduceDivisions(size_t begin, size_t end);
+    void optimizeLoop(const CodeAnalysis &info, const FlowGraph::Loop &loop, 
+        CodeEditor &editor);
+    void hoistInvariants(const CodeAnalysis &info, const FlowGraph::Loop &loop,
+        const LoopFacts &facts, CodeEditor &editor, CodeEditor::Code &preheader);
+    void reduceInductions(const CodeAnalysis &info, const FlowGraph::Loop &loop,
+        const LoopFacts &facts, CodeEditor &editor, CodeEditor::Code &preheader);
+
+    bool isInvariant(const CodeAnalysis &info, const LoopFacts &facts, 
+        size_t start, size_t end) const;
+    bool executesFirst(const CodeAnalysis &info, const FlowGraph::Loop &loop, 
+        size_t addr) const;
+    CodeAnalysis::VarList checkedNumeric(const CodeAnalysis &info, 
+        const FlowGraph::Loop &loop, const LoopFacts &facts) const;
+
+    Program &m_prog;
+    Optimizer &m_optimizer;
+};
+
+#endif // LOOPOPTIMIZER_H
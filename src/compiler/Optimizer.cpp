@@ -0,0 +1,80 @@
+#include <cstdio>
+#include "Optimizer.h"
+#include "EscapeOptimizer.h"
+#include "LoopOptimizer.h"
+#include "BoundsCheckEliminator.h"
+#include "CommonSubexpressionEliminator.h"
+
+// Append code to dest, moving its addresses by offset
+static void relocate(const Program &code, size_t begin, size_t end, long offset,
+    Program &dest)
+{
+  for (size_t addr = begin; addr < end; addr++)
+  {
+    Instruction instr = code[addr];
+    if (instr.hasAddress())
+      instr.arg.addr += offset;
+    dest.write(instr);
+  }
+}
+
+void Optimizer::run()
+{
+  // Each function is optimized on its own copy, so that an edit does
+  // not have to move the code of every function after it
+  Program optimized;
+  size_t first = (m_prog.entryCount() > 0)? m_prog.entry(0).addr : m_prog.size();
+  relocate(m_prog, 0, first, 0, optimized);
+  for (size_t i=0; i<m_prog.entryCount(); i++)
+  {
+    size_t begin = m_prog.entry(i).addr;
+    size_t end = (i+1 < m_prog.entryCount())? m_prog.entry(i+1).addr : m_prog.size();
+
+    Program fun;
+    for (size_t g=0; g<m_prog.globalsCount(); g++)
+      fun.addGlobal(m_prog.global(g));
+    relocate(m_prog, begin, end, -static_cast<long>(begin), fun);
+
+    end = EscapeOptimizer(fun, *this).optimize(0, fun.size());
+    end = LoopOptimizer(fun, *this).optimize(0, end);
+    end = BoundsCheckEliminator(fun, *this).optimize(0, end);
+    CommonSubexpressionEliminator(fun, *this).optimize(0, end);
+
+    m_prog.moveEntry(i, optimized.size());
+    relocate(fun, 0, fun.size(), optimized.size(), optimized);
+  }
+
+  // The entry points are moved already
+  m_prog.replaceCode(optimized);
+}
+
+Atom Optimizer::temp()
+{
+  char name[16];
+  snprintf(name, sizeof(name), "%%%lu", static_cast<unsigned long>(m_temps.size()));
+  Atom temp(name, m_strings);
+  m_temps.push_back(temp.id());
+  return temp;
+}
+
+bool Optimizer::isTemp(StringTable::Ref var) const
+{
+  for (size_t i=0; i<m_temps.size(); i++)
+    if (m_temps[i] == var)
+      return true;
+  return false;
+}
+
+StringTable::Ref Optimizer::builtin(const char *name)
+{
+  StringTable::Ref id = m_strings->id(name);
+  for (size_t i=0; i<m_prog.entryCount(); i++)
+    if (m_prog.entry(i).name.id() == id)
+    {
+      // Scripts cannot name a function with a '%'
+      char shadowed[64];
+      snprintf(shadowed, sizeof(shadowed), "%%%s", name);
+      return m_strings->id(shadowed);
+    }
+  return id;
+}
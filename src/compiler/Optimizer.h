@@ -0,0 +1,45 @@
+#ifndef OPTIMIZER_H
+#define OPTIMIZER_H
+
+#include "Program.h"
+#include "StringTable.h"
+
+/**
+ * Runs the optimization passes over every function of a Program.
+ *
+ * Works on the linear code, after the whole program has been loaded 
+ * (so that the set of globals is final).
+ */
+class Optimizer
+{
+  public:
+    struct Stats
+    {
+      Stats(): scalarArrays(0), frameArrays(0) {}
+      // Allocation sites of arrays which do not escape
+      unsigned int scalarArrays;
+      unsigned int frameArrays;
+    };
+
+    Optimizer(Program &prog, StringTable *strings)
+      : m_prog(prog), m_strings(strings) {}
+
+    void run();
+    Stats &stats() { return m_stats; }
+
+    // A fresh variable which cannot clash with the script's ones
+    Atom temp();
+    bool isTemp(StringTable::Ref var) const;
+    // The name a builtin is called by, or one no call uses when the
+    // script defines a function of that name instead
+    StringTable::Ref builtin(const char *name);
+    StringTable *strings() const { return m_strings; }
+
+  private:
+    Program &m_prog;
+    StringTable *m_strings;
+    Vector<StringTable::Ref> m_temps;
+    Stats m_stats;
+};
+
+#endif // OPTIMIZER_H
@@ -22,19 +22,19 @@ TopLevel *Parser::readTopLevel()
 
     expect(Base::FuncCall);
     const Atom name = next<FuncCall>()->name();
-    deleteNext();
+    skipNext();
 
-    SafePtr<Expression> arg(readSExpr());
-    expectLValue(arg.keep());
-    SafePtr<Operator> body(readBlock());
+    Expression *arg = readSExpr();
+    expectLValue(arg);
+    Operator *body = readBlock();
 
-    return new Fun(name, arg, body);
+    return new (m_arena) Fun(name, arg, body);
   }
   else if (nextIsSym(Symbol::Global))
   {
     consumeSym(Symbol::Global);
     expect(Base::Variable);
-    return new GlobalVar(takeNext<Variable>());
+    return new (m_arena) GlobalVar(takeNext<Variable>());
   }
   else
     throw Exception("TopLevel", next<Base>()->region());
@@ -65,19 +65,19 @@ Operator *Parser::readOperator()
   else 
   {
     // LET or DO
-    SafePtr<Expression> expr(readSExpr());
+    Expression *expr = readSExpr();
     if (nextIs(Base::Infix) && next<Infix>()->subtype() == Infix::Equals)
     {
       // LET
       expectLValue(expr);
-      deleteNext();
-      SafePtr<Expression> rvalue(readExpr());
-      return new Let(expr, rvalue);
+      skipNext();
+      Expression *rvalue = readExpr();
+      return new (m_arena) Let(expr, rvalue);
     }
     else
     {
       // DO
-      return new Do(expr);
+      return new (m_arena) Do(expr);
     }
   }
 }
@@ -86,24 +86,24 @@ Operator *Parser::readOperator()
 Operator *Parser::readOperatorReturn()
 {
   consumeSym(Symbol::Return);
-  SafePtr<Expression> expr(readExpr());
-  return new Return(expr);
+  Expression *expr = readExpr();
+  return new (m_arena) Return(expr);
 }
 
 // IF
 Operator *Parser::readOperatorIf()
 {
   consumeSym(Symbol::If);
-  SafePtr<Expression> cond(readExpr());
+  Expression *cond = readExpr();
   consumeSym(Symbol::Then);
-  SafePtr<Operator> positive(readBlock());
-  SafePtr<Operator> negative(NULL);
+  Operator *positive = readBlock();
+  Operator *negative = NULL;
   if (nextIsSym(Symbol::Else))
   {
     consumeSym(Symbol::Else);
     negative = readBlock();
   }
-  return new If(cond, positive, negative);
+  return new (m_arena) If(cond, positive, negative);
 }
 
 // FOR
@@ -111,24 +111,24 @@ Operator *Parser::readOperatorFor()
 {
   consumeSym(Symbol::For);
   expect(Base::Variable);
-  SafePtr<Variable> var(takeNext<Variable>());
+  Variable *var = takeNext<Variable>();
   consumeSym(Symbol::From);
-  SafePtr<Expression> from(readExpr());
+  Expression *from = readExpr();
   consumeSym(Symbol::To);
-  SafePtr<Expression> to(readExpr());
+  Expression *to = readExpr();
   consumeSym(Symbol::Do);
-  SafePtr<Operator> body(readBlock());
-  return new For(var, from, to, body);
+  Operator *body = readBlock();
+  return new (m_arena) For(var, from, to, body);
 }
 
 // WHILE
 Operator *Parser::readOperatorWhile()
 {
   consumeSym(Symbol::While);
-  SafePtr<Expression> cond(readExpr());
+  Expression *cond = readExpr();
   consumeSym(Symbol::Do);
-  SafePtr<Operator> body(readBlock());
-  return new While(cond, body);
+  Operator *body = readBlock();
+  return new (m_arena) While(cond, body);
 }
 
 // ===== EXPRESSIONS
@@ -172,8 +172,8 @@ Expression *Parser::readSExpr()
 // FUNCTION CALL
 Expression *Parser::readSExprFuncCall()
 {
-  SafePtr<FuncCall> func(takeNext<FuncCall>());
-  SafePtr<Expression> arg(readSExpr());
+  FuncCall *func = takeNext<FuncCall>();
+  Expression *arg = readSExpr();
   func->bind(arg);
   return func;
 }
@@ -181,8 +181,8 @@ Expression *Parser::readSExprFuncCall()
 // ARRAY ITEM
 Expression *Parser::readSExprArrayItem()
 {
-  SafePtr<ArrayItem> array(takeNext<ArrayItem>());
-  SafePtr<Expression> arg(readSExpr());
+  ArrayItem *array = takeNext<ArrayItem>();
+  Expression *arg = readSExpr();
   array->bind(arg);
   return array;
 }
@@ -191,19 +191,19 @@ Expression *Parser::readSExprArrayItem()
 Expression *Parser::readSExprSelector()
 {
   consumeSym(Symbol::If);
-  SafePtr<Expression> cond(readExpr());
+  Expression *cond = readExpr();
   consumeSym(Symbol::Then);
-  SafePtr<Expression> positive(readExpr());
+  Expression *positive = readExpr();
   consumeSym(Symbol::Else);
-  SafePtr<Expression> negative(readExpr());
-  return new Selector(cond, positive, negative);
+  Expression *negative = readExpr();
+  return new (m_arena) Selector(cond, positive, negative);
 }
 
 // (SUBEXPRESSION)
 Expression *Parser::readSExprSubexpr()
 {
   consumeSym(Symbol::LParen);
-  SafePtr<Expression> inside(readExpr());
+  Expression *inside = readExpr();
   consumeSym(Symbol::RParen);
   return inside;
 }
@@ -222,7 +222,7 @@ Expression *Parser::readSExprTuple()
       break;
   }
   consumeSym(Symbol::RBracket);
-  return new Tuple(exprs.takeAll());
+  return new (m_arena) Tuple(exprs.takeAll());
 }
 
 // ====== HELPERS ======
@@ -305,7 +305,7 @@ void Parser::consumeSym(Symbol::Subtype t)
   if (!nextIsSym(t))
     throw SymbolExpected(t, next<Base>()->region());
   else
-    deleteNext();
+    skipNext();
 }
 
 bool Parser::nextIs(Base::Type t)
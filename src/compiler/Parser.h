@@ -4,6 +4,7 @@
 #include "AST.h"
 #include "ListBuilder.h"
 #include "DataSource.h"
+#include "Arena.h"
 
 class Parser: public DataSource<AST::TopLevel *>
 {
@@ -29,8 +30,9 @@ class Parser: public DataSource<AST::TopLevel *>
         AST::Symbol::Subtype m_symbol;
     };
 
-    Parser(DataSource<AST::Base *> *source): m_source(source), m_next(NULL) {}
-    ~Parser() { delete m_next; }
+    // Nodes are placed in arena, along with the lexems they are made of
+    Parser(DataSource<AST::Base *> *source, Arena &arena)
+      : m_source(source), m_next(NULL), m_arena(arena) {}
 
     virtual AST::TopLevel *getNext();
 
@@ -76,10 +78,11 @@ class Parser: public DataSource<AST::TopLevel *>
       return n;
     }
 
-    void deleteNext() { delete takeNext<AST::Base>(); }
+    void skipNext() { takeNext<AST::Base>(); }
 
     DataSource<AST::Base *> *m_source;
     AST::Base *m_next;
+    Arena &m_arena;
 };
 
 #endif // PARSER_H
@@ -2,35 +2,48 @@
 #include <cstdarg>
 #include "LoadedProgram.h"
 #include "FileCharSource.h"
+#include "HashingCharSource.h"
 #include "File.h"
 #include "Lexer.h"
 #include "Parser.h"
 #include "Compiler.h"
+#include "Optimizer.h"
 #include "Symbols.h"
 #include "ASTPrint.h"
+#include "Arena.h"
+#include "Clock.h"
 
-LoadedProgram::LoadedProgram(DataSource<int> &src)
+LoadedProgram::LoadedProgram(DataSource<int> &src, bool optimize)
+  : m_sourceHash(0)
 {
-  load(src);
+  load(src, optimize);
 }
 
-LoadedProgram::LoadedProgram(const char *filename)
+LoadedProgram::LoadedProgram(const char *filename, bool optimize)
+  : m_sourceHash(0)
 {
   File file(filename, File::Read);
   FileCharSource fileSrc(&file);
-  load(fileSrc);
+  load(fileSrc, optimize);
 }
 
-void LoadedProgram::load(DataSource<int> &src)
+void LoadedProgram::load(DataSource<int> &src, bool optimize)
 {
   try
   {
-    Lexer lexer(&src, &m_strings);
-    Parser parser(&lexer);
+    unsigned long start = Clock::micros();
+    // The syntax trees of the whole source, freed at once
+    Arena arena;
+    HashingCharSource hashSrc(&src);
+    Lexer lexer(&hashSrc, &m_strings, arena);
+    Parser parser(&lexer, arena);
     Compiler compiler(*this);
 
     // (Read -> Tokenize -> Lex -> Parse) chain
+    // Every function is declared before compiling, so that calls know
+    // whether the script defines a builtin's name itself
     AST::TopLevel *ast;
+    Vector<AST::Fun *> funs;
     while ((ast = parser.getNext()) != NULL)
     {
 #if DEBUG_OUTPUT
@@ -38,10 +51,25 @@ void LoadedProgram::load(DataSource<int> &src)
       cerr.printf("\n");
 #endif
       if (ast->type() == AST::Base::Fun)
-        compiler.compile(ast->as<AST::Fun>());
+      {
+        compiler.declare(ast->as<AST::Fun>());
+        funs.push_back(ast->as<AST::Fun>());
+      }
       else if (ast->type() == AST::Base::GlobalVar)
         addGlobal(ast->as<AST::GlobalVar>()->var()->name().id());
-      deleteChain(ast);
+    }
+    for (size_t i=0; i<funs.size(); i++)
+      compiler.compile(funs[i]);
+    m_sourceHash = hashSrc.hash();
+    m_loadStats.chars = lexer.charCount();
+    m_loadStats.tokens = lexer.tokenCount();
+    m_loadStats.micros = Clock::micros() - start;
+
+    if (optimize)
+    {
+      Optimizer optimizer(*this, &m_strings);
+      optimizer.run();
+      m_optimizerStats = optimizer.stats();
     }
 #ifdef DEBUG_OUTPUT
     cerr.printf("\n");
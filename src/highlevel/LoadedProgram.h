@@ -5,6 +5,7 @@
 #include "DataSource.h"
 #include "String.h"
 #include "StringTable.h"
+#include "Optimizer.h"
 
 class LoadedProgram: public Program
 {
@@ -19,17 +20,34 @@ class LoadedProgram: public Program
         String m_text;
     };
 
-    LoadedProgram(DataSource<int> &src);
+    struct LoadStats
+    {
+      LoadStats(): chars(0), tokens(0), micros(0) {}
+      size_t chars;
+      size_t tokens;
+      // Spent reading, parsing and compiling, before optimization
+      unsigned long micros;
+    };
+
+    LoadedProgram(DataSource<int> &src, bool optimize=true);
     // Convenience: load from file
-    LoadedProgram(const char *file);
+    LoadedProgram(const char *file, bool optimize=true);
 
     const StringTable *strings() const { return &m_strings; }
     StringTable *strings() { return &m_strings; }
+
+    // FNV-1a hash of the source text
+    unsigned int sourceHash() const { return m_sourceHash; }
+    const Optimizer::Stats &optimizerStats() const { return m_optimizerStats; }
+    const LoadStats &loadStats() const { return m_loadStats; }
   private:
-    void load(DataSource<int> &src);
+    void load(DataSource<int> &src, bool optimize);
     void error(const char *format, ...);
     
     StringTable m_strings;
+    unsigned int m_sourceHash;
+    Optimizer::Stats m_optimizerStats;
+    LoadStats m_loadStats;
 };
 
 #endif // LOADEDPROGRAM_H
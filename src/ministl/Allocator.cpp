@@ -0,0 +1,64 @@
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include <malloc.h>
+
+#include "Allocator.h"
+#include "SlabAllocator.h"
+
+Allocator *Allocator::s_instance = NULL;
+
+Allocator *Allocator::create()
+{
+  // Never deleted, see the class comment
+  const char *name = getenv("MSL_ALLOCATOR");
+  if (name != NULL && 0 == strcmp(name, "malloc"))
+    s_instance = new MallocAllocator();
+  else if (name != NULL && 0 == strcmp(name, "huge"))
+    s_instance = new SlabAllocator(true);
+  else
+    s_instance = new SlabAllocator(false);
+  return s_instance;
+}
+
+void *Allocator::reallocate(void *p, size_t oldSize, size_t newSize)
+{
+  void *q = allocate(newSize);
+  if (p != NULL)
+  {
+    memcpy(q, p, oldSize < newSize? oldSize : newSize);
+    deallocate(p, oldSize);
+  }
+  return q;
+}
+
+
+void *MallocAllocator::allocate(size_t size)
+{
+  void *p = malloc(size);
+  if (p == NULL)
+    throw std::bad_alloc();
+  m_inUse += size;
+  m_reserved += malloc_usable_size(p);
+  return p;
+}
+
+void MallocAllocator::deallocate(void *p, size_t size)
+{
+  if (p == NULL)
+    return;
+  m_inUse -= size;
+  m_reserved -= malloc_usable_size(p);
+  free(p);
+}
+
+void *MallocAllocator::reallocate(void *p, size_t oldSize, size_t newSize)
+{
+  size_t reserved = p != NULL? malloc_usable_size(p) : 0;
+  void *q = realloc(p, newSize);
+  if (q == NULL)
+    throw std::bad_alloc();
+  m_inUse += newSize - oldSize;
+  m_reserved += malloc_usable_size(q) - reserved;
+  return q;
+}
@@ -0,0 +1,59 @@
+#ifndef ALLOCATOR_H
+#define ALLOCATOR_H
+
+#include <cstddef>
+
+/**
+ * Raw memory for Buffer, Vector and ArrayStorage.
+ *
+ * Blocks are freed and resized with the size they were asked for.
+ * The allocator in use is chosen on first use by the MSL_ALLOCATOR
+ * environment variable:
+ * - slab: size classes carved from slabs (see SlabAllocator), the
+ *   default;
+ * - huge: slab, with large blocks mapped on huge pages;
+ * - malloc: the C library's.
+ * It lives until the program exits: static objects may still free 
+ * memory then.
+ */
+class Allocator
+{
+  public:
+    Allocator(): m_inUse(0), m_reserved(0) {}
+    virtual ~Allocator() {}
+
+    virtual const char *name() const = 0;
+    virtual void *allocate(size_t size) = 0;
+    virtual void deallocate(void *p, size_t size) = 0;
+    virtual void *reallocate(void *p, size_t oldSize, size_t newSize);
+
+    // Bytes asked for and not freed yet
+    size_t bytesInUse() const { return m_inUse; }
+    // Bytes taken from the system for them
+    size_t bytesReserved() const { return m_reserved; }
+    // Share of the reserved bytes not in use
+    double fragmentation() const
+      { return m_reserved == 0? 0.0 : 1.0 - static_cast<double>(m_inUse) / m_reserved; }
+
+    static Allocator *instance()
+      { return s_instance != NULL? s_instance : create(); }
+
+  protected:
+    size_t m_inUse;
+    size_t m_reserved;
+
+  private:
+    static Allocator *create();
+    static Allocator *s_instance;
+};
+
+class MallocAllocator: public Allocator
+{
+  public:
+    const char *name() const { return "malloc"; }
+    void *allocate(size_t size);
+    void deallocate(void *p, size_t size);
+    void *reallocate(void *p, size_t oldSize, size_t newSize);
+};
+
+#endif // ALLOCATOR_H
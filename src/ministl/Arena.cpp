@@ -0,0 +1,41 @@
+#include <cstring>
+#include "Arena.h"
+#include "Allocator.h"
+
+Arena::~Arena()
+{
+  while (m_chunks != NULL)
+  {
+    Chunk *next = m_chunks->next;
+    Allocator::instance()->deallocate(m_chunks, m_chunks->size);
+    m_chunks = next;
+  }
+}
+
+char *Arena::copy(const char *str)
+{
+  size_t length = strlen(str);
+  char *p = static_cast<char *>(allocate(length+1));
+  memcpy(p, str, length+1);
+  return p;
+}
+
+void *Arena::allocateChunk(size_t size)
+{
+  // A large block gets a chunk of its own, leaving the current one open
+  bool own = size > ChunkSize / 4;
+  size_t chunkSize = HeaderSize + (own? size : ChunkSize);
+  Chunk *chunk = static_cast<Chunk *>(Allocator::instance()->allocate(chunkSize));
+  chunk->size = chunkSize;
+  chunk->next = m_chunks;
+  m_chunks = chunk;
+  m_bytes += chunkSize;
+
+  char *p = reinterpret_cast<char *>(chunk) + HeaderSize;
+  if (!own)
+  {
+    m_free = p + size;
+    m_left = ChunkSize - size;
+  }
+  return p;
+}
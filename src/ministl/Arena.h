@@ -0,0 +1,64 @@
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <cstddef>
+
+/**
+ * A bump-pointer region.
+ *
+ * Blocks are carved one after another from chunks taken from the
+ * Allocator, and are never freed one by one: the whole region goes
+ * at once with the Arena. Objects placed in it (see operator new
+ * below) are not destroyed, so they must not own other memory.
+ */
+class Arena
+{
+  public:
+    static const size_t ChunkSize = 16 << 10;
+    static const size_t Alignment = sizeof(double) > sizeof(void *)?
+                                    sizeof(double) : sizeof(void *);
+
+    Arena(): m_chunks(NULL), m_free(NULL), m_left(0), m_bytes(0) {}
+    ~Arena();
+
+    void *allocate(size_t size)
+    {
+      size = (size + Alignment-1) & ~(Alignment-1);
+      if (size > m_left)
+        return allocateChunk(size);
+      void *p = m_free;
+      m_free += size;
+      m_left -= size;
+      return p;
+    }
+
+    // Copy of a zero-terminated string
+    char *copy(const char *str);
+
+    // Bytes taken for chunks
+    size_t bytesReserved() const { return m_bytes; }
+
+  private:
+    struct Chunk
+    {
+      Chunk *next;
+      size_t size;
+    };
+    static const size_t HeaderSize = (sizeof(Chunk) + Alignment-1) & ~(Alignment-1);
+
+    Arena(const Arena &);
+    void operator =(const Arena &);
+
+    void *allocateChunk(size_t size);
+
+    Chunk *m_chunks;
+    char *m_free;
+    size_t m_left;
+    size_t m_bytes;
+};
+
+inline void *operator new(size_t size, Arena &arena) { return arena.allocate(size); }
+// Only called when a constructor throws; the block goes with the arena
+inline void operator delete(void *, Arena &) {}
+
+#endif // ARENA_H
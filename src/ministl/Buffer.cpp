@@ -1,7 +1,5 @@
-#include <cstdlib>
-#include <new>
-
 #include "Buffer.h"
+#include "Allocator.h"
 
 BufferBackend::BufferBackend(size_t init_size)
   : mem_size(0), mem_data(NULL)
@@ -11,22 +9,18 @@ BufferBackend::BufferBackend(size_t init_size)
 
 BufferBackend::~BufferBackend()
 {
-  if (mem_data != NULL)
-    free(mem_data);
+  Allocator::instance()->deallocate(mem_data, mem_size);
 }
 
 void BufferBackend::rawReserve(size_t size)
 {
   if (size <= mem_size) 
     return;
-  mem_size = ((size + mem_block_size-1) / mem_block_size) * mem_block_size;
-
-  if (mem_data == 0)
-    mem_data = malloc(mem_size);
-  else
-    mem_data = realloc(mem_data, mem_size);
-
-  if (mem_data == NULL)
-    throw std::bad_alloc();
+  // Geometric growth keeps appending one by one linear
+  size_t new_size = ((size + mem_block_size-1) / mem_block_size) * mem_block_size;
+  if (mem_size != 0 && new_size < 2*mem_size)
+    new_size = 2*mem_size;
+  mem_data = Allocator::instance()->reallocate(mem_data, mem_size, new_size);
+  mem_size = new_size;
 }
 
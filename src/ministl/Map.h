@@ -38,6 +38,11 @@ class Map
         return 0;
     }
 
+    // Introspection
+    size_t size() const { return m_data.size(); }
+    const K &keyAt(size_t i) const { return m_data[i].key; }
+    const V &valueAt(size_t i) const { return m_data[i].val; }
+
   private:
     struct Binding
     {
@@ -0,0 +1,162 @@
+#include <cstdlib>
+#include <new>
+#include <malloc.h>
+#include <sys/mman.h>
+
+#include "SlabAllocator.h"
+
+static size_t hugeRound(size_t size)
+{
+  return (size + SlabAllocator::HugePage-1) / SlabAllocator::HugePage * SlabAllocator::HugePage;
+}
+
+SlabAllocator::SlabAllocator(bool hugePages)
+  : m_hugePages(hugePages), m_classCount(0)
+{
+  // 16, 32, ... 128, then 160, 192, 224, 256, 320, ... MaxSmall
+  for (size_t size = Granule; size <= 128; size += Granule)
+    m_classSize[m_classCount++] = size;
+  for (size_t p = 128; p < MaxSmall; p *= 2)
+    for (size_t k = 1; k <= 4; k++)
+      m_classSize[m_classCount++] = p + k * p / 4;
+  for (size_t c = 0; c < m_classCount; c++)
+    m_free[c] = NULL;
+
+  size_t c = 0;
+  for (size_t i=0; i <= MaxSmall / Granule; i++)
+  {
+    while (m_classSize[c] < i * Granule)
+      c++;
+    m_classOf[i] = c;
+  }
+}
+
+void *SlabAllocator::allocate(size_t size)
+{
+  m_inUse += size;
+  if (size > MaxSmall)
+  {
+    if (m_hugePages && size >= HugeSize)
+      return mapHuge(size);
+    void *p = malloc(size);
+    if (p == NULL)
+      throw std::bad_alloc();
+    m_reserved += malloc_usable_size(p);
+    return p;
+  }
+
+  size_t c = classOf(size);
+  if (m_free[c] == NULL)
+    refill(c);
+  FreeBlock *block = m_free[c];
+  m_free[c] = block->next;
+  return block;
+}
+
+void SlabAllocator::deallocate(void *p, size_t size)
+{
+  if (p == NULL)
+    return;
+  m_inUse -= size;
+  if (size > MaxSmall)
+  {
+    if (m_hugePages && size >= HugeSize)
+      unmapHuge(p, size);
+    else
+    {
+      m_reserved -= malloc_usable_size(p);
+      free(p);
+    }
+    return;
+  }
+
+  size_t c = classOf(size);
+  FreeBlock *block = static_cast<FreeBlock *>(p);
+  block->next = m_free[c];
+  m_free[c] = block;
+}
+
+void *SlabAllocator::reallocate(void *p, size_t oldSize, size_t newSize)
+{
+  if (p == NULL)
+    return allocate(newSize);
+
+  // Still fits its block
+  if (oldSize <= MaxSmall && newSize <= MaxSmall && classOf(oldSize) == classOf(newSize))
+  {
+    m_inUse += newSize - oldSize;
+    return p;
+  }
+
+  // Both from malloc, or both mapped
+  bool oldHuge = m_hugePages && oldSize >= HugeSize;
+  bool newHuge = m_hugePages && newSize >= HugeSize;
+  if (oldSize > MaxSmall && newSize > MaxSmall && oldHuge == newHuge)
+  {
+    void *q;
+    if (newHuge)
+    {
+      q = mremap(p, hugeRound(oldSize), hugeRound(newSize), MREMAP_MAYMOVE);
+      if (q == MAP_FAILED)
+        throw std::bad_alloc();
+      m_reserved += hugeRound(newSize) - hugeRound(oldSize);
+    }
+    else
+    {
+      size_t reserved = malloc_usable_size(p);
+      q = realloc(p, newSize);
+      if (q == NULL)
+        throw std::bad_alloc();
+      m_reserved += malloc_usable_size(q) - reserved;
+    }
+    m_inUse += newSize - oldSize;
+    return q;
+  }
+  return Allocator::reallocate(p, oldSize, newSize);
+}
+
+void SlabAllocator::refill(size_t c)
+{
+  char *slab = static_cast<char *>(malloc(SlabSize));
+  if (slab == NULL)
+    throw std::bad_alloc();
+  m_reserved += SlabSize;
+
+  size_t size = m_classSize[c];
+  for (size_t offset = 0; offset + size <= SlabSize; offset += size)
+  {
+    FreeBlock *block = reinterpret_cast<FreeBlock *>(slab + offset);
+    block->next = m_free[c];
+    m_free[c] = block;
+  }
+}
+
+
+void *SlabAllocator::mapHuge(size_t size)
+{
+  size_t length = hugeRound(size);
+  void *p = MAP_FAILED;
+#ifdef MAP_HUGETLB
+  p = mmap(NULL, length, PROT_READ | PROT_WRITE, 
+      MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+#endif
+  if (p == MAP_FAILED)
+  {
+    // No huge pages reserved: let the kernel merge pages later
+    p = mmap(NULL, length, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (p == MAP_FAILED)
+      throw std::bad_alloc();
+#ifdef MADV_HUGEPAGE
+    madvise(p, length, MADV_HUGEPAGE);
+#endif
+  }
+  m_reserved += length;
+  return p;
+}
+
+void SlabAllocator::unmapHuge(void *p, size_t size)
+{
+  size_t length = hugeRound(size);
+  munmap(p, length);
+  m_reserved -= length;
+}
@@ -0,0 +1,54 @@
+#ifndef SLAB_ALLOCATOR_H
+#define SLAB_ALLOCATOR_H
+
+#include "Allocator.h"
+
+/**
+ * A size-class allocator.
+ *
+ * Small blocks are rounded up to a size class: multiples of 16 up to
+ * 128 bytes, then four classes per power of two up to MaxSmall. Each
+ * class carves its blocks from slabs of SlabSize bytes, and keeps the 
+ * freed ones on a free list. Slabs are never returned.
+ *
+ * Larger blocks go to malloc; with huge pages on, blocks of HugeSize
+ * and more are mapped on their own, on huge pages where the system 
+ * has them, or else on pages advised to become huge.
+ */
+class SlabAllocator: public Allocator
+{
+  public:
+    static const size_t MaxSmall = 4096;
+    static const size_t SlabSize = 64 << 10;
+    static const size_t HugeSize = 256 << 10;
+    static const size_t HugePage = 2 << 20;
+
+    SlabAllocator(bool hugePages);
+
+    const char *name() const { return m_hugePages? "huge" : "slab"; }
+    void *allocate(size_t size);
+    void deallocate(void *p, size_t size);
+    void *reallocate(void *p, size_t oldSize, size_t newSize);
+
+  private:
+    static const size_t Granule = 16;
+    static const size_t MaxClasses = 32;
+
+    struct FreeBlock
+    {
+      FreeBlock *next;
+    };
+
+    size_t classOf(size_t size) const { return m_classOf[(size + Granule-1) / Granule]; }
+    void refill(size_t c);
+    void *mapHuge(size_t size);
+    void unmapHuge(void *p, size_t size);
+
+    bool m_hugePages;
+    size_t m_classCount;
+    size_t m_classSize[MaxClasses];
+    unsigned char m_classOf[MaxSmall / Granule + 1];
+    FreeBlock *m_free[MaxClasses];
+};
+
+#endif // SLAB_ALLOCATOR_H
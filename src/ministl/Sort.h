@@ -0,0 +1,126 @@
+#ifndef SORT_H
+#define SORT_H
+
+#include <cstddef>
+#include "Util.h"
+
+/**
+ * Introsort of n items by a strict weak ordering less(a, b).
+ *
+ * Quicksort on median-of-three pivots, turning to heapsort when the
+ * partitions go 2 log n deep (so O(n log n) at worst), and to
+ * insertion sort for runs too short to partition. Not stable.
+ */
+template<class T, class Less>
+void introsort(T *items, size_t n, Less less);
+
+// Runs this short are insertion sorted
+static const size_t SortRun = 16;
+
+template<class T, class Less>
+void insertionSort(T *items, size_t n, Less less)
+{
+  for (size_t i=1; i<n; i++)
+  {
+    T x = items[i];
+    size_t j = i;
+    for (; j>0 && less(x, items[j-1]); j--)
+      items[j] = items[j-1];
+    items[j] = x;
+  }
+}
+
+template<class T, class Less>
+void siftDown(T *items, size_t root, size_t n, Less less)
+{
+  T x = items[root];
+  for (;;)
+  {
+    size_t child = 2*root + 1;
+    if (child >= n)
+      break;
+    if (child+1 < n && less(items[child], items[child+1]))
+      child++;
+    if (!less(x, items[child]))
+      break;
+    items[root] = items[child];
+    root = child;
+  }
+  items[root] = x;
+}
+
+template<class T, class Less>
+void heapSort(T *items, size_t n, Less less)
+{
+  for (size_t i = n/2; i-- > 0; )
+    siftDown(items, i, n, less);
+  for (size_t end = n; end-- > 1; )
+  {
+    swap(items[0], items[end]);
+    siftDown(items, 0, end, less);
+  }
+}
+
+template<class T, class Less>
+void introsortLoop(T *items, size_t n, size_t depth, Less less)
+{
+  while (n > SortRun)
+  {
+    if (depth == 0)
+    {
+      heapSort(items, n, less);
+      return;
+    }
+    depth--;
+
+    // The median of three goes in the middle, the others are the
+    // sentinels of the partition scans
+    size_t mid = n/2;
+    if (less(items[mid], items[0]))
+      swap(items[mid], items[0]);
+    if (less(items[n-1], items[mid]))
+    {
+      swap(items[n-1], items[mid]);
+      if (less(items[mid], items[0]))
+        swap(items[mid], items[0]);
+    }
+    T pivot = items[mid];
+
+    // Hoare partition: [0, j] and [j+1, n), neither empty
+    size_t i = 0, j = n-1;
+    for (;;)
+    {
+      do i++; while (less(items[i], pivot));
+      do j--; while (less(pivot, items[j]));
+      if (i >= j)
+        break;
+      swap(items[i], items[j]);
+    }
+
+    // Recurse on the shorter part, loop on the longer one
+    size_t left = j+1;
+    if (left < n-left)
+    {
+      introsortLoop(items, left, depth, less);
+      items += left;
+      n -= left;
+    }
+    else
+    {
+      introsortLoop(items+left, n-left, depth, less);
+      n = left;
+    }
+  }
+  insertionSort(items, n, less);
+}
+
+template<class T, class Less>
+void introsort(T *items, size_t n, Less less)
+{
+  size_t depth = 0;
+  for (size_t m = n; m > 1; m /= 2)
+    depth += 2;
+  introsortLoop(items, n, depth, less);
+}
+
+#endif // SORT_H
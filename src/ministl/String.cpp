@@ -1,45 +1,88 @@
 #include <cstring>
 #include "String.h"
+#include "Allocator.h"
 
 String::String(const char *str)
-  : m_length(strlen(str)), m_data(strlen(str)+1)
+  : m_data(m_small), m_length(0), m_capacity(SmallSize)
 {
-  strcpy(m_data.data(), str);
+  assign(str, strlen(str));
 }
 
 String::String(const String &str)
-  : m_length(str.length()), m_data(str.length()+1)
+  : m_data(m_small), m_length(0), m_capacity(SmallSize)
 {
-  strcpy(m_data.data(), str.m_data.data());
+  assign(str.c_str(), str.length());
 }
 
+String::~String()
+{
+  if (!isSmall())
+    Allocator::instance()->deallocate(m_data, m_capacity);
+}
 
-String &String::operator =(const String &str)
+void String::grow(size_t capacity)
 {
-  m_length = str.length();
-  m_data.reserve(m_length+1);
-  strcpy(m_data.data(), str.m_data.data());
-  return *this;
+  if (capacity <= m_capacity)
+    return;
+  if (capacity < 2*m_capacity)
+    capacity = 2*m_capacity;
+  Allocator *allocator = Allocator::instance();
+  if (isSmall())
+  {
+    m_data = static_cast<char *>(allocator->allocate(capacity));
+    memcpy(m_data, m_small, m_length+1);
+  }
+  else
+    m_data = static_cast<char *>(allocator->reallocate(m_data, m_capacity, capacity));
+  m_capacity = capacity;
+}
+
+void String::assign(const char *str, size_t length)
+{
+  grow(length+1);
+  memmove(m_data, str, length+1);
+  m_length = length;
 }
 
-String &String::operator +=(char c)
+void String::take(String &str)
+{
+  if (str.isSmall())
+    memcpy(m_small, str.m_small, str.m_length+1);
+  else
+  {
+    m_data = str.m_data;
+    m_capacity = str.m_capacity;
+    str.m_data = str.m_small;
+    str.m_capacity = SmallSize;
+  }
+  m_length = str.m_length;
+  str.clear();
+}
+
+void String::swap(String &str)
+{
+  String tmp;
+  tmp.take(*this);
+  take(str);
+  str.take(tmp);
+}
+
+String &String::operator =(const String &str)
 {
-  m_data.reserve(m_length+2);
-  m_data[m_length++] = c;
-  m_data[m_length] = '\0';
+  assign(str.c_str(), str.length());
   return *this;
 }
 
 String &String::operator +=(const String &str)
 {
-  m_data.reserve(m_length+str.length()+1);
-  strcpy(m_data.data()+m_length, str.c_str());
-  m_length += str.length();
+  size_t length = str.length();
+  grow(m_length+length+1);
+  memmove(m_data+m_length, str.c_str(), length+1);
+  m_length += length;
   return *this;
 }
 
 bool String::operator ==(const char *str) const
 {
-  return 0 == strcmp(m_data.data(), str);
+  return 0 == strcmp(m_data, str);
 }
- 
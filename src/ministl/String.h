@@ -2,35 +2,64 @@
 #define STRING_H
 
 #include <cstddef>
-#include "Buffer.h"
 
+/**
+ * A zero-terminated string.
+ *
+ * Strings shorter than SmallSize are kept inline, without allocating;
+ * longer ones grow geometrically. There are no rvalue references to
+ * move with: swap() exchanges contents without copying them.
+ */
 class String
 {
   public:
+    // Inline capacity, including the terminator
+    static const size_t SmallSize = 16;
+
     String(const char *str = "");
     String(const String &str);
+    ~String();
 
     size_t length() const { return m_length; }
-    const char *c_str() const { return m_data.data(); }
+    const char *c_str() const { return m_data; }
     bool empty() const { return length()==0; }
-    void clear() { *this = ""; }
+    // Keeps the capacity
+    void clear() { m_length = 0; m_data[0] = '\0'; }
+    void swap(String &str);
 
     String &operator =(const String &str);
-    String &operator +=(char c);
+    String &operator +=(char c)
+    {
+      if (m_length+1 >= m_capacity)
+        grow(m_length+2);
+      m_data[m_length++] = c;
+      m_data[m_length] = '\0';
+      return *this;
+    }
     String &operator +=(const String &str);
 
     bool operator ==(const char *str) const; 
     bool operator ==(const String &str) const 
-      { return *this == str.m_data.data(); }
+      { return *this == str.c_str(); }
 
     bool operator !=(const char *str) const
       { return !(*this == str); }
     bool operator !=(const String &str) const 
-      { return !(*this == str.m_data.data()); }
+      { return !(*this == str.c_str()); }
 
   private:
+    bool isSmall() const { return m_data == m_small; }
+    // Make room for capacity chars, including the terminator
+    void grow(size_t capacity);
+    // Take the contents of str, leaving it empty; this must be empty
+    // and inline
+    void take(String &str);
+    void assign(const char *str, size_t length);
+
+    char *m_data;
     size_t m_length;
-    Buffer<char> m_data;
+    size_t m_capacity;
+    char m_small[SmallSize];
 };
 
 #endif // STRING_H
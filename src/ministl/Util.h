@@ -13,4 +13,12 @@ T max(T a, T b)
   return a>b? a : b;
 }
 
+template<class T>
+void swap(T &a, T &b)
+{
+  T t = a;
+  a = b;
+  b = t;
+}
+
 #endif // UTIL_H
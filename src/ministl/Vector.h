@@ -1,7 +1,9 @@
 #ifndef VECTOR_H
 #define VECTOR_H
 
+#include <new>
 #include "Buffer.h"
+#include "Allocator.h"
 
 template<class T>
 class Vector
@@ -14,7 +16,7 @@ class Vector
       : m_size(other.size()), m_data(other.size())
     {
       for (size_t i=0; i<m_size; i++)
-        m_data[i] = new T(*other.m_data[i]);
+        m_data[i] = create(*other.m_data[i]);
     }
 
     Vector<T> &operator=(const Vector<T> &other)
@@ -39,13 +41,13 @@ class Vector
       {
         m_data.reserve(new_size);
         for (size_t i=m_size; i<new_size; i++)
-          m_data[i] = new T();
+          m_data[i] = create(T());
       }
       else if (new_size < m_size)
       {
         for (size_t i=new_size; i<m_size; i++)
         {
-          delete m_data[i];
+          destroy(m_data[i]);
           m_data[i] = NULL;
         }
       }
@@ -58,13 +60,22 @@ class Vector
     void push_back(const T &v)
     {
       m_data.reserve(m_size+1);
-      m_data[m_size++] = new T(v);
+      m_data[m_size++] = create(v);
     }
     void pop_back()
     {
       resize(m_size-1);
     }
   private:
+    // Items are allocated one by one
+    static T *create(const T &v)
+      { return new (Allocator::instance()->allocate(sizeof(T))) T(v); }
+    static void destroy(T *p)
+    {
+      p->~T();
+      Allocator::instance()->deallocate(p, sizeof(T));
+    }
+
     size_t m_size;
     Buffer<T *> m_data;
 };
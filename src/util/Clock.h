@@ -0,0 +1,21 @@
+#ifndef CLOCK_H
+#define CLOCK_H
+
+#include <sys/time.h>
+
+/**
+ * Wall clock time, for measuring short intervals.
+ */
+class Clock
+{
+  public:
+    // Microseconds since an arbitrary point
+    static unsigned long micros()
+    {
+      timeval tv;
+      gettimeofday(&tv, NULL);
+      return static_cast<unsigned long>(tv.tv_sec) * 1000000ul + tv.tv_usec;
+    }
+};
+
+#endif // CLOCK_H
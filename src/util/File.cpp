@@ -43,6 +43,17 @@ int File::printf(const char *format, ...)
   return retval;
 }
 
+int File::scanf(const char *format, ...)
+{
+  va_list args;
+  va_start(args, format);
+  int retval = vfscanf(m_file, format, args);
+  va_end(args);
+  if (retval == EOF && ferror(m_file))
+    throw Exception(errno);
+  return retval;
+}
+
 int File::getc()
 {
   return fgetc(m_file);
@@ -26,6 +26,7 @@ class File
     ~File();
 
     int printf(const char *format, ...);
+    int scanf(const char *format, ...);
     int getc();
 
     void close();
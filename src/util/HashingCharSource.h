@@ -0,0 +1,34 @@
+#ifndef HASHINGCHARSOURCE_H
+#define HASHINGCHARSOURCE_H
+
+#include <cstdio>
+#include "DataSource.h"
+
+/**
+ * Passes characters through, computing their FNV-1a hash on the way.
+ */
+class HashingCharSource: public DataSource<int>
+{
+  public:
+    HashingCharSource(DataSource<int> *src)
+      : m_src(src), m_hash(2166136261u) {}
+    // Reimplemented from DataSource<int>
+    virtual int getNext() 
+    { 
+      int c = m_src->getNext();
+      if (c != EOF)
+      {
+        m_hash ^= static_cast<unsigned char>(c);
+        m_hash *= 16777619u;
+      }
+      return c;
+    }
+
+    unsigned int hash() const { return m_hash; }
+
+  private:
+    DataSource<int> *m_src;
+    unsigned int m_hash;
+};
+
+#endif // HASHINGCHARSOURCE_H
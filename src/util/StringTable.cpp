@@ -1,12 +1,6 @@
 #include <cstring>
 #include "StringTable.h"
 
-StringTable::~StringTable()
-{
-  for (size_t i=0; i<m_strs.size(); i++)
-    delete[] m_strs[i];
-}
-
 StringTable::Ref StringTable::id(const char *str)
 {
   unsigned int ret = 0;
@@ -29,10 +23,7 @@ bool StringTable::find(const char *str, StringTable::Ref &where)
 
 StringTable::Ref StringTable::add(const char *str)
 {
-  size_t length = strlen(str);
-  char *stored = new char[length+1];
-  memcpy(stored, str, length+1);
-  m_strs.push_back(stored);
+  m_strs.push_back(m_arena.copy(str));
   return m_strs.size()-1;
 }
 
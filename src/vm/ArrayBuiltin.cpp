@@ -0,0 +1,505 @@
+#include <cstring>
+#include "ArrayBuiltin.h"
+#include "ArrayKernels.h"
+#include "Sort.h"
+
+
+const ListedBuiltin::Definition ArrayBuiltin::defs[] =
+{
+  {"fill", ArrayBuiltin::fill},
+  {"copy", ArrayBuiltin::copy},
+  {"sum", ArrayBuiltin::sum},
+  {"dot", ArrayBuiltin::dot},
+  {"minmax", ArrayBuiltin::minmax},
+  {"scale", ArrayBuiltin::scale},
+  {"axpy", ArrayBuiltin::axpy},
+  {"find", ArrayBuiltin::find},
+  {"sort", ArrayBuiltin::sort},
+  {"sortdesc", ArrayBuiltin::sortdesc},
+  {"argsort", ArrayBuiltin::argsort},
+  {"bsearch", ArrayBuiltin::bsearch},
+};
+
+ArrayBuiltin::ArrayBuiltin(StringTable *strings)
+  : ListedBuiltin(strings, defs, sizeof(defs)/sizeof(ListedBuiltin::Definition))
+{
+}
+
+// Items as typed arrays take them
+static int intItem(const Value &v)
+{
+  if (v.type() != Value::Int)
+    throw ArrayStorage::BadItem(Value::Int, v.type());
+  return v.asInt();
+}
+
+static double realItem(const Value &v)
+{
+  if (v.type() == Value::Int)
+    return v.asInt();
+  if (v.type() != Value::Real)
+    throw ArrayStorage::BadItem(Value::Real, v.type());
+  return v.asReal();
+}
+
+static void checkSizes(const ArrayStorage &arrays, const Value &a, const Value &b)
+{
+  if (arrays.size(a) != arrays.size(b))
+    throw ArrayStorage::SizeMismatch();
+}
+
+void ArrayBuiltin::fill(ListedBuiltin *, Context &context)
+{
+  CallArgs args(context, 2);
+  ArrayStorage &arrays = context.arrays;
+  Value a = args.array(0);
+  Value x = args[1];
+  size_t n = arrays.size(a);
+  switch (arrays.kind(a))
+  {
+    case ArrayStorage::Ints:
+      ArrayKernels::fill(arrays.writableInts(a), n, intItem(x));
+      break;
+    case ArrayStorage::Reals:
+      ArrayKernels::fill(arrays.writableReals(a), n, realItem(x));
+      break;
+    default:
+      for (size_t i=1; i<=n; i++)
+        arrays.setUnchecked(a, i, x);
+  }
+  args.ret();
+}
+
+void ArrayBuiltin::copy(ListedBuiltin *, Context &context)
+{
+  CallArgs args(context, 2);
+  ArrayStorage &arrays = context.arrays;
+  Value dst = args.array(0);
+  Value src = args.array(1);
+  size_t n = arrays.size(src);
+  if (arrays.size(dst) < n)
+    throw ArrayStorage::BadSize();
+  ArrayStorage::Kind to = arrays.kind(dst);
+  ArrayStorage::Kind from = arrays.kind(src);
+  if (to == ArrayStorage::Ints && from == ArrayStorage::Ints)
+  {
+    int *items = arrays.writableInts(dst);
+    memmove(items, arrays.ints(src), n * sizeof(int));
+  }
+  else if (to == ArrayStorage::Reals && from == ArrayStorage::Reals)
+  {
+    double *items = arrays.writableReals(dst);
+    memmove(items, arrays.reals(src), n * sizeof(double));
+  }
+  else if (to == ArrayStorage::Reals && from == ArrayStorage::Ints)
+  {
+    double *items = arrays.writableReals(dst);
+    const int *ints = arrays.ints(src);
+    for (size_t i=0; i<n; i++)
+      items[i] = ints[i];
+  }
+  else
+  {
+    for (size_t i=1; i<=n; i++)
+      arrays.setUnchecked(dst, i, arrays.getUnchecked(src, i));
+  }
+  args.ret();
+}
+
+void ArrayBuiltin::sum(ListedBuiltin *, Context &context)
+{
+  CallArgs args(context, 1);
+  const ArrayStorage &arrays = context.arrays;
+  Value a = args.array(0);
+  size_t n = arrays.size(a);
+  switch (arrays.kind(a))
+  {
+    case ArrayStorage::Ints:
+      args.ret(ArrayKernels::sum(arrays.ints(a), n));
+      break;
+    case ArrayStorage::Reals:
+      args.ret(ArrayKernels::sum(arrays.reals(a), n));
+      break;
+    default:
+    {
+      Value s = 0;
+      for (size_t i=1; i<=n; i++)
+        s = s + arrays.getUnchecked(a, i);
+      args.ret(s);
+    }
+  }
+}
+
+void ArrayBuiltin::dot(ListedBuiltin *, Context &context)
+{
+  CallArgs args(context, 2);
+  const ArrayStorage &arrays = context.arrays;
+  Value a = args.array(0);
+  Value b = args.array(1);
+  checkSizes(arrays, a, b);
+  size_t n = arrays.size(a);
+  ArrayStorage::Kind kind = arrays.kind(a);
+  if (kind == ArrayStorage::Ints && arrays.kind(b) == kind)
+    args.ret(ArrayKernels::dot(arrays.ints(a), arrays.ints(b), n));
+  else if (kind == ArrayStorage::Reals && arrays.kind(b) == kind)
+    args.ret(ArrayKernels::dot(arrays.reals(a), arrays.reals(b), n));
+  else
+  {
+    Value s = 0;
+    for (size_t i=1; i<=n; i++)
+      s = s + arrays.getUnchecked(a, i) * arrays.getUnchecked(b, i);
+    args.ret(s);
+  }
+}
+
+void ArrayBuiltin::minmax(ListedBuiltin *, Context &context)
+{
+  CallArgs args(context, 1);
+  const ArrayStorage &arrays = context.arrays;
+  Value a = args.array(0);
+  size_t n = arrays.size(a);
+  if (n == 0)
+    throw ArrayStorage::BadSize();
+  switch (arrays.kind(a))
+  {
+    case ArrayStorage::Ints:
+    {
+      int min, max;
+      ArrayKernels::minmax(arrays.ints(a), n, min, max);
+      args.ret(min, max);
+    } break;
+    case ArrayStorage::Reals:
+    {
+      double min, max;
+      ArrayKernels::minmax(arrays.reals(a), n, min, max);
+      args.ret(min, max);
+    } break;
+    default:
+    {
+      Value min = arrays.getUnchecked(a, 1);
+      Value max = min;
+      for (size_t i=2; i<=n; i++)
+      {
+        Value v = arrays.getUnchecked(a, i);
+        if ((v < min).asBool())
+          min = v;
+        if ((v > max).asBool())
+          max = v;
+      }
+      args.ret(min, max);
+    }
+  }
+}
+
+void ArrayBuiltin::scale(ListedBuiltin *, Context &context)
+{
+  CallArgs args(context, 2);
+  ArrayStorage &arrays = context.arrays;
+  Value a = args.array(0);
+  Value x = args[1];
+  size_t n = arrays.size(a);
+  switch (arrays.kind(a))
+  {
+    case ArrayStorage::Ints:
+      ArrayKernels::scale(arrays.writableInts(a), n, intItem(x));
+      break;
+    case ArrayStorage::Reals:
+      ArrayKernels::scale(arrays.writableReals(a), n, realItem(x));
+      break;
+    default:
+      for (size_t i=1; i<=n; i++)
+        arrays.setUnchecked(a, i, arrays.getUnchecked(a, i) * x);
+  }
+  args.ret();
+}
+
+void ArrayBuiltin::axpy(ListedBuiltin *, Context &context)
+{
+  CallArgs args(context, 3);
+  ArrayStorage &arrays = context.arrays;
+  Value alpha = args[0];
+  Value x = args.array(1);
+  Value y = args.array(2);
+  checkSizes(arrays, x, y);
+  size_t n = arrays.size(y);
+  ArrayStorage::Kind kind = arrays.kind(y);
+  if (kind == ArrayStorage::Ints && arrays.kind(x) == kind)
+  {
+    int *items = arrays.writableInts(y);
+    ArrayKernels::axpy(intItem(alpha), arrays.ints(x), items, n);
+  }
+  else if (kind == ArrayStorage::Reals && arrays.kind(x) == kind)
+  {
+    double *items = arrays.writableReals(y);
+    ArrayKernels::axpy(realItem(alpha), arrays.reals(x), items, n);
+  }
+  else
+  {
+    for (size_t i=1; i<=n; i++)
+      arrays.setUnchecked(y, i, alpha * arrays.getUnchecked(x, i) + arrays.getUnchecked(y, i));
+  }
+  args.ret();
+}
+
+// As =, with arrays equal to themselves only
+static bool equal(const Value &a, const Value &b)
+{
+  if (a.type() != b.type())
+    return false;
+  if (a.type() == Value::Array)
+    return a.asArray() == b.asArray() && a.arrayGeneration() == b.arrayGeneration();
+  return (a == b).asBool();
+}
+
+void ArrayBuiltin::find(ListedBuiltin *, Context &context)
+{
+  CallArgs args(context, 2);
+  const ArrayStorage &arrays = context.arrays;
+  Value a = args.array(0);
+  Value x = args[1];
+  size_t n = arrays.size(a);
+  // Reals arrays hold Ints widened
+  size_t pos = n;
+  ArrayStorage::Kind kind = arrays.kind(a);
+  if (kind == ArrayStorage::Ints && x.type() == Value::Int)
+    pos = ArrayKernels::find(arrays.ints(a), n, x.asInt());
+  else if (kind == ArrayStorage::Reals && (x.type() == Value::Int || x.type() == Value::Real))
+    pos = ArrayKernels::find(arrays.reals(a), n, realItem(x));
+  else if (kind == ArrayStorage::Boxed || kind == ArrayStorage::Bits)
+  {
+    for (pos = 0; pos < n; pos++)
+      if (equal(arrays.getUnchecked(a, pos+1), x))
+        break;
+  }
+  args.ret(pos < n? static_cast<int>(pos+1) : 0);
+}
+
+// Orders of items, as <
+static bool lessItem(int a, int b) { return a < b; }
+static bool lessItem(double a, double b) { return a < b; }
+static bool lessItem(const Value &a, const Value &b)
+{
+  if (a.type() == Value::Int && b.type() == Value::Int)
+    return a.asInt() < b.asInt();
+  return a.toReal() < b.toReal();
+}
+
+template<class T>
+struct Ascending
+{
+  bool operator ()(const T &a, const T &b) const { return lessItem(a, b); }
+};
+
+template<class T>
+struct Descending
+{
+  bool operator ()(const T &a, const T &b) const { return lessItem(b, a); }
+};
+
+// Indices ordered by their keys, then by themselves
+template<class T>
+struct ByKey
+{
+  ByKey(const T *keys): keys(keys) {}
+  bool operator ()(int a, int b) const
+  {
+    return lessItem(keys[a], keys[b]) || (!lessItem(keys[b], keys[a]) && a < b);
+  }
+  const T *keys;
+};
+
+// LSD radix sort by bytes. Flipping the sign bit orders negative ints
+// first; passes where every item has the same byte are skipped.
+static void radixSort(int *items, size_t n)
+{
+  if (n <= SortRun)
+  {
+    insertionSort(items, n, Ascending<int>());
+    return;
+  }
+  int *buffer = new int[n];
+  int *from = items;
+  int *to = buffer;
+  for (unsigned int shift = 0; shift < 32; shift += 8)
+  {
+    size_t counts[256] = {0};
+    for (size_t i=0; i<n; i++)
+      counts[((static_cast<unsigned int>(from[i]) ^ 0x80000000u) >> shift) & 0xff]++;
+    if (counts[((static_cast<unsigned int>(from[0]) ^ 0x80000000u) >> shift) & 0xff] == n)
+      continue;
+    size_t pos = 0;
+    for (size_t d=0; d<256; d++)
+    {
+      size_t count = counts[d];
+      counts[d] = pos;
+      pos += count;
+    }
+    for (size_t i=0; i<n; i++)
+      to[counts[((static_cast<unsigned int>(from[i]) ^ 0x80000000u) >> shift) & 0xff]++] = from[i];
+    swap(from, to);
+  }
+  if (from != items)
+    memcpy(items, from, n * sizeof(int));
+  delete[] buffer;
+}
+
+template<class T>
+static void reverse(T *items, size_t n)
+{
+  for (size_t i=0, j=n; i+1 < j; i++, j--)
+    swap(items[i], items[j-1]);
+}
+
+static void sortInts(int *items, size_t n, bool descending)
+{
+  radixSort(items, n);
+  if (descending)
+    reverse(items, n);
+}
+
+// Items [first, first+n) of A, which must all be numbers
+static void sortBoxed(ArrayStorage &arrays, const Value &a, size_t first, size_t n,
+    bool descending)
+{
+  Value *items = new Value[n];
+  bool ints = true;
+  for (size_t i=0; i<n; i++)
+  {
+    items[i] = arrays.getUnchecked(a, first+i+1);
+    if (items[i].type() == Value::Real)
+      ints = false;
+    else if (items[i].type() != Value::Int)
+    {
+      delete[] items;
+      throw Value::TypeMismatch();
+    }
+  }
+  if (ints)
+  {
+    int *keys = new int[n];
+    for (size_t i=0; i<n; i++)
+      keys[i] = items[i].asInt();
+    sortInts(keys, n, descending);
+    for (size_t i=0; i<n; i++)
+      items[i] = keys[i];
+    delete[] keys;
+  }
+  else if (descending)
+    introsort(items, n, Descending<Value>());
+  else
+    introsort(items, n, Ascending<Value>());
+  for (size_t i=0; i<n; i++)
+    arrays.setUnchecked(a, first+i+1, items[i]);
+  delete[] items;
+}
+
+void ArrayBuiltin::sortRange(Context &context, bool descending)
+{
+  bool range = CallArgs::isTuple(context);
+  CallArgs args(context, range? 3 : 1);
+  ArrayStorage &arrays = context.arrays;
+  Value a = args.array(0);
+  size_t first = 0;
+  size_t n = arrays.size(a);
+  if (range)
+  {
+    Value l = args[1];
+    Value r = args[2];
+    if (l.type() != Value::Int || r.type() != Value::Int)
+      throw Context::BadType();
+    // An empty range needs no index at all
+    if (!arrays.inRange(a, l.asInt(), r.asInt()))
+      throw ArrayStorage::BadIndex();
+    n = 0;
+    if (l.asInt() <= r.asInt())
+    {
+      first = l.asInt() - 1;
+      n = r.asInt() - l.asInt() + 1;
+    }
+  }
+
+  switch (arrays.kind(a))
+  {
+    case ArrayStorage::Ints:
+      sortInts(arrays.writableInts(a) + first, n, descending);
+      break;
+    case ArrayStorage::Reals:
+      if (descending)
+        introsort(arrays.writableReals(a) + first, n, Descending<double>());
+      else
+        introsort(arrays.writableReals(a) + first, n, Ascending<double>());
+      break;
+    default:
+      sortBoxed(arrays, a, first, n, descending);
+  }
+  args.ret();
+}
+
+void ArrayBuiltin::sort(ListedBuiltin *, Context &context)
+{
+  sortRange(context, false);
+}
+
+void ArrayBuiltin::sortdesc(ListedBuiltin *, Context &context)
+{
+  sortRange(context, true);
+}
+
+void ArrayBuiltin::argsort(ListedBuiltin *, Context &context)
+{
+  CallArgs args(context, 1);
+  ArrayStorage &arrays = context.arrays;
+  Value a = args.array(0);
+  size_t n = arrays.size(a);
+  ArrayStorage::Kind kind = arrays.kind(a);
+  Value order = arrays.alloc(n, ArrayStorage::Ints);
+  int *indices = arrays.writableInts(order);
+  for (size_t i=0; i<n; i++)
+    indices[i] = i;
+
+  if (kind == ArrayStorage::Ints)
+    introsort(indices, n, ByKey<int>(arrays.ints(a)));
+  else if (kind == ArrayStorage::Reals)
+    introsort(indices, n, ByKey<double>(arrays.reals(a)));
+  else
+  {
+    Value *keys = new Value[n];
+    for (size_t i=0; i<n; i++)
+    {
+      keys[i] = arrays.getUnchecked(a, i+1);
+      if (keys[i].type() != Value::Int && keys[i].type() != Value::Real)
+      {
+        delete[] keys;
+        throw Value::TypeMismatch();
+      }
+    }
+    introsort(indices, n, ByKey<Value>(keys));
+    delete[] keys;
+  }
+
+  for (size_t i=0; i<n; i++)
+    indices[i]++;
+  args.ret(order);
+}
+
+void ArrayBuiltin::bsearch(ListedBuiltin *, Context &context)
+{
+  CallArgs args(context, 2);
+  const ArrayStorage &arrays = context.arrays;
+  Value a = args.array(0);
+  Value x = args[1];
+  if (x.type() != Value::Int && x.type() != Value::Real)
+    throw Value::TypeMismatch();
+  // The first item not less than X
+  size_t low = 0, high = arrays.size(a);
+  while (low < high)
+  {
+    size_t mid = low + (high-low)/2;
+    if (lessItem(arrays.getUnchecked(a, mid+1), x))
+      low = mid+1;
+    else
+      high = mid;
+  }
+  bool found = low < arrays.size(a) && !lessItem(x, arrays.getUnchecked(a, low+1));
+  args.ret(found? static_cast<int>(low+1) : 0);
+}
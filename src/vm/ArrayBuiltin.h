@@ -0,0 +1,54 @@
+#ifndef ARRAYBUILTIN_H
+#define ARRAYBUILTIN_H
+
+#include "Builtin.h"
+
+/**
+ * Bulk array operations, a call for a whole loop:
+ *   fill [A, X]        every item of A set to X
+ *   copy [Dst, Src]    the items of Src to the first ones of Dst
+ *   sum A, dot [A, B]  sum of the items, of the products of items
+ *   minmax A           [Min, Max] of a non-empty A
+ *   scale [A, X]       every item of A multiplied by X
+ *   axpy [Alpha, X, Y] Y set to Alpha*X + Y
+ *   find [A, X]        index of the first item equal to X, 0 if none
+ *   sort A, sort [A, L, R], sortdesc A, sortdesc [A, L, R]
+ *                      A, or its items L to R, sorted in place
+ *   argsort A          intarray of the indices of A in ascending order
+ *                      of their items, equal ones in index order
+ *   bsearch [A, X]     index of the first item of ascending A neither
+ *                      less nor greater than X, 0 if none
+ *
+ * Typed arrays are processed by ArrayKernels, other ones item by item
+ * with the executor's arithmetic. Arrays taken together must be of
+ * the same size (Dst may be longer).
+ *
+ * Items are ordered as by <: Ints with Ints, anything else as Reals.
+ * Only arrays of numbers can be sorted. Int items are radix sorted, 
+ * the others introsorted.
+ */
+class ArrayBuiltin: public ListedBuiltin
+{
+  public:
+    ArrayBuiltin(StringTable *strings);
+
+  private:
+    static void fill(ListedBuiltin *self, Context &context);
+    static void copy(ListedBuiltin *self, Context &context);
+    static void sum(ListedBuiltin *self, Context &context);
+    static void dot(ListedBuiltin *self, Context &context);
+    static void minmax(ListedBuiltin *self, Context &context);
+    static void scale(ListedBuiltin *self, Context &context);
+    static void axpy(ListedBuiltin *self, Context &context);
+    static void find(ListedBuiltin *self, Context &context);
+    static void sort(ListedBuiltin *self, Context &context);
+    static void sortdesc(ListedBuiltin *self, Context &context);
+    static void argsort(ListedBuiltin *self, Context &context);
+    static void bsearch(ListedBuiltin *self, Context &context);
+
+    static void sortRange(Context &context, bool descending);
+
+    static const ListedBuiltin::Definition defs[];
+};
+
+#endif // ARRAYBUILTIN_H
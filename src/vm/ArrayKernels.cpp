@@ -0,0 +1,802 @@
+#include <cstdlib>
+#include <cstring>
+#include "ArrayKernels.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define X86_KERNELS
+#include <immintrin.h>
+#define SSE2_CODE __attribute__((target("sse2")))
+#define AVX2_CODE __attribute__((target("avx2")))
+#endif
+
+static ArrayKernels::Level detect()
+{
+  ArrayKernels::Level best = ArrayKernels::Scalar;
+#ifdef X86_KERNELS
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("sse2"))
+    best = ArrayKernels::SSE2;
+  if (__builtin_cpu_supports("avx2"))
+    best = ArrayKernels::AVX2;
+#endif
+  // Never raised past what the CPU supports
+  const char *name = getenv("MSL_SIMD");
+  if (name != NULL && 0 == strcmp(name, "scalar"))
+    best = ArrayKernels::Scalar;
+  else if (name != NULL && 0 == strcmp(name, "sse2") && best > ArrayKernels::SSE2)
+    best = ArrayKernels::SSE2;
+  return best;
+}
+
+ArrayKernels::Level ArrayKernels::level()
+{
+  static Level level = detect();
+  return level;
+}
+
+const char *ArrayKernels::levelName()
+{
+  static const char *names[] = {"scalar", "sse2", "avx2"};
+  return names[level()];
+}
+
+
+// Scalar code, the reference for the vector versions. Ints are
+// added and multiplied as unsigned to wrap around.
+
+static void fillScalar(int *items, size_t n, int x)
+{
+  for (size_t i=0; i<n; i++)
+    items[i] = x;
+}
+
+static void fillScalar(double *items, size_t n, double x)
+{
+  for (size_t i=0; i<n; i++)
+    items[i] = x;
+}
+
+static int sumScalar(const int *items, size_t n, size_t from = 0)
+{
+  unsigned int s = 0;
+  for (size_t i=from; i<n; i++)
+    s += items[i];
+  return s;
+}
+
+static double sumScalar(const double *items, size_t n, size_t from = 0)
+{
+  double s = 0;
+  for (size_t i=from; i<n; i++)
+    s += items[i];
+  return s;
+}
+
+static int dotScalar(const int *a, const int *b, size_t n, size_t from = 0)
+{
+  unsigned int s = 0;
+  for (size_t i=from; i<n; i++)
+    s += static_cast<unsigned int>(a[i]) * b[i];
+  return s;
+}
+
+static double dotScalar(const double *a, const double *b, size_t n, size_t from = 0)
+{
+  double s = 0;
+  for (size_t i=from; i<n; i++)
+    s += a[i] * b[i];
+  return s;
+}
+
+// Takes min and max further over [from, n)
+template <typename T>
+static void widen(const T *items, size_t from, size_t n, T &min, T &max)
+{
+  for (size_t i=from; i<n; i++)
+  {
+    if (items[i] < min)
+      min = items[i];
+    if (items[i] > max)
+      max = items[i];
+  }
+}
+
+template <typename T>
+static void minmaxScalar(const T *items, size_t n, T &min, T &max)
+{
+  min = max = items[0];
+  widen(items, 1, n, min, max);
+}
+
+static void scaleScalar(int *items, size_t n, int x, size_t from = 0)
+{
+  for (size_t i=from; i<n; i++)
+    items[i] = static_cast<unsigned int>(items[i]) * x;
+}
+
+static void scaleScalar(double *items, size_t n, double x, size_t from = 0)
+{
+  for (size_t i=from; i<n; i++)
+    items[i] *= x;
+}
+
+static void axpyScalar(int alpha, const int *x, int *y, size_t n, size_t from = 0)
+{
+  for (size_t i=from; i<n; i++)
+    y[i] = static_cast<unsigned int>(alpha) * x[i] + y[i];
+}
+
+static void axpyScalar(double alpha, const double *x, double *y, size_t n, size_t from = 0)
+{
+  for (size_t i=from; i<n; i++)
+    y[i] = alpha * x[i] + y[i];
+}
+
+template <typename T>
+static size_t findScalar(const T *items, size_t n, T x, size_t from = 0)
+{
+  for (size_t i=from; i<n; i++)
+    if (items[i] == x)
+      return i;
+  return n;
+}
+
+
+#ifdef X86_KERNELS
+
+// SSE2: 4 ints or 2 reals a vector. It has no 32-bit multiply, nor
+// 32-bit min and max: they are made of wider or simpler operations.
+
+SSE2_CODE static inline __m128i mulloSse2(__m128i a, __m128i b)
+{
+  __m128i even = _mm_mul_epu32(a, b);
+  __m128i odd = _mm_mul_epu32(_mm_srli_epi64(a, 32), _mm_srli_epi64(b, 32));
+  return _mm_unpacklo_epi32(_mm_shuffle_epi32(even, _MM_SHUFFLE(0, 0, 2, 0)),
+                            _mm_shuffle_epi32(odd, _MM_SHUFFLE(0, 0, 2, 0)));
+}
+
+SSE2_CODE static inline __m128i selectSse2(__m128i mask, __m128i a, __m128i b)
+{
+  return _mm_or_si128(_mm_and_si128(mask, a), _mm_andnot_si128(mask, b));
+}
+
+SSE2_CODE static void fillSse2(int *items, size_t n, int x)
+{
+  __m128i v = _mm_set1_epi32(x);
+  size_t i = 0;
+  for (; i+4 <= n; i += 4)
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(items+i), v);
+  for (; i<n; i++)
+    items[i] = x;
+}
+
+SSE2_CODE static void fillSse2(double *items, size_t n, double x)
+{
+  __m128d v = _mm_set1_pd(x);
+  size_t i = 0;
+  for (; i+2 <= n; i += 2)
+    _mm_storeu_pd(items+i, v);
+  for (; i<n; i++)
+    items[i] = x;
+}
+
+SSE2_CODE static int sumSse2(const int *items, size_t n)
+{
+  __m128i acc = _mm_setzero_si128();
+  size_t i = 0;
+  for (; i+4 <= n; i += 4)
+    acc = _mm_add_epi32(acc, _mm_loadu_si128(reinterpret_cast<const __m128i *>(items+i)));
+  int lanes[4];
+  _mm_storeu_si128(reinterpret_cast<__m128i *>(lanes), acc);
+  return sumScalar(lanes, 4) + static_cast<unsigned int>(sumScalar(items, n, i));
+}
+
+SSE2_CODE static double sumSse2(const double *items, size_t n)
+{
+  __m128d acc = _mm_setzero_pd();
+  size_t i = 0;
+  for (; i+2 <= n; i += 2)
+    acc = _mm_add_pd(acc, _mm_loadu_pd(items+i));
+  double lanes[2];
+  _mm_storeu_pd(lanes, acc);
+  return lanes[0] + lanes[1] + sumScalar(items, n, i);
+}
+
+SSE2_CODE static int dotSse2(const int *a, const int *b, size_t n)
+{
+  __m128i acc = _mm_setzero_si128();
+  size_t i = 0;
+  for (; i+4 <= n; i += 4)
+    acc = _mm_add_epi32(acc, mulloSse2(
+          _mm_loadu_si128(reinterpret_cast<const __m128i *>(a+i)),
+          _mm_loadu_si128(reinterpret_cast<const __m128i *>(b+i))));
+  int lanes[4];
+  _mm_storeu_si128(reinterpret_cast<__m128i *>(lanes), acc);
+  return sumScalar(lanes, 4) + static_cast<unsigned int>(dotScalar(a, b, n, i));
+}
+
+SSE2_CODE static double dotSse2(const double *a, const double *b, size_t n)
+{
+  __m128d acc = _mm_setzero_pd();
+  size_t i = 0;
+  for (; i+2 <= n; i += 2)
+    acc = _mm_add_pd(acc, _mm_mul_pd(_mm_loadu_pd(a+i), _mm_loadu_pd(b+i)));
+  double lanes[2];
+  _mm_storeu_pd(lanes, acc);
+  return lanes[0] + lanes[1] + dotScalar(a, b, n, i);
+}
+
+SSE2_CODE static void minmaxSse2(const int *items, size_t n, int &min, int &max)
+{
+  __m128i lo = _mm_set1_epi32(items[0]);
+  __m128i hi = lo;
+  size_t i = 0;
+  for (; i+4 <= n; i += 4)
+  {
+    __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(items+i));
+    lo = selectSse2(_mm_cmplt_epi32(v, lo), v, lo);
+    hi = selectSse2(_mm_cmpgt_epi32(v, hi), v, hi);
+  }
+  int los[4], his[4];
+  _mm_storeu_si128(reinterpret_cast<__m128i *>(los), lo);
+  _mm_storeu_si128(reinterpret_cast<__m128i *>(his), hi);
+  minmaxScalar(los, 4, min, max);
+  widen(his, 0, 4, min, max);
+  widen(items, i, n, min, max);
+}
+
+SSE2_CODE static void minmaxSse2(const double *items, size_t n, double &min, double &max)
+{
+  __m128d lo = _mm_set1_pd(items[0]);
+  __m128d hi = lo;
+  size_t i = 0;
+  for (; i+2 <= n; i += 2)
+  {
+    __m128d v = _mm_loadu_pd(items+i);
+    lo = _mm_min_pd(lo, v);
+    hi = _mm_max_pd(hi, v);
+  }
+  double los[2], his[2];
+  _mm_storeu_pd(los, lo);
+  _mm_storeu_pd(his, hi);
+  minmaxScalar(los, 2, min, max);
+  widen(his, 0, 2, min, max);
+  widen(items, i, n, min, max);
+}
+
+SSE2_CODE static void scaleSse2(int *items, size_t n, int x)
+{
+  __m128i v = _mm_set1_epi32(x);
+  size_t i = 0;
+  for (; i+4 <= n; i += 4)
+  {
+    __m128i *p = reinterpret_cast<__m128i *>(items+i);
+    _mm_storeu_si128(p, mulloSse2(_mm_loadu_si128(p), v));
+  }
+  scaleScalar(items, n, x, i);
+}
+
+SSE2_CODE static void scaleSse2(double *items, size_t n, double x)
+{
+  __m128d v = _mm_set1_pd(x);
+  size_t i = 0;
+  for (; i+2 <= n; i += 2)
+    _mm_storeu_pd(items+i, _mm_mul_pd(_mm_loadu_pd(items+i), v));
+  scaleScalar(items, n, x, i);
+}
+
+SSE2_CODE static void axpySse2(int alpha, const int *x, int *y, size_t n)
+{
+  __m128i a = _mm_set1_epi32(alpha);
+  size_t i = 0;
+  for (; i+4 <= n; i += 4)
+  {
+    __m128i *p = reinterpret_cast<__m128i *>(y+i);
+    __m128i v = mulloSse2(a, _mm_loadu_si128(reinterpret_cast<const __m128i *>(x+i)));
+    _mm_storeu_si128(p, _mm_add_epi32(v, _mm_loadu_si128(p)));
+  }
+  axpyScalar(alpha, x, y, n, i);
+}
+
+SSE2_CODE static void axpySse2(double alpha, const double *x, double *y, size_t n)
+{
+  __m128d a = _mm_set1_pd(alpha);
+  size_t i = 0;
+  for (; i+2 <= n; i += 2)
+    _mm_storeu_pd(y+i, _mm_add_pd(_mm_mul_pd(a, _mm_loadu_pd(x+i)), _mm_loadu_pd(y+i)));
+  axpyScalar(alpha, x, y, n, i);
+}
+
+SSE2_CODE static size_t findSse2(const int *items, size_t n, int x)
+{
+  __m128i v = _mm_set1_epi32(x);
+  size_t i = 0;
+  for (; i+4 <= n; i += 4)
+  {
+    __m128i eq = _mm_cmpeq_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i *>(items+i)), v);
+    int mask = _mm_movemask_epi8(eq);
+    if (mask != 0)
+      return i + __builtin_ctz(mask) / 4;
+  }
+  return findScalar(items, n, x, i);
+}
+
+SSE2_CODE static size_t findSse2(const double *items, size_t n, double x)
+{
+  __m128d v = _mm_set1_pd(x);
+  size_t i = 0;
+  for (; i+2 <= n; i += 2)
+  {
+    int mask = _mm_movemask_pd(_mm_cmpeq_pd(_mm_loadu_pd(items+i), v));
+    if (mask != 0)
+      return i + __builtin_ctz(mask);
+  }
+  return findScalar(items, n, x, i);
+}
+
+
+// AVX2: 8 ints or 4 reals a vector
+
+AVX2_CODE static void fillAvx2(int *items, size_t n, int x)
+{
+  __m256i v = _mm256_set1_epi32(x);
+  size_t i = 0;
+  for (; i+8 <= n; i += 8)
+    _mm256_storeu_si256(reinterpret_cast<__m256i *>(items+i), v);
+  for (; i<n; i++)
+    items[i] = x;
+}
+
+AVX2_CODE static void fillAvx2(double *items, size_t n, double x)
+{
+  __m256d v = _mm256_set1_pd(x);
+  size_t i = 0;
+  for (; i+4 <= n; i += 4)
+    _mm256_storeu_pd(items+i, v);
+  for (; i<n; i++)
+    items[i] = x;
+}
+
+AVX2_CODE static int sumAvx2(const int *items, size_t n)
+{
+  __m256i acc = _mm256_setzero_si256();
+  size_t i = 0;
+  for (; i+8 <= n; i += 8)
+    acc = _mm256_add_epi32(acc, _mm256_loadu_si256(reinterpret_cast<const __m256i *>(items+i)));
+  int lanes[8];
+  _mm256_storeu_si256(reinterpret_cast<__m256i *>(lanes), acc);
+  return sumScalar(lanes, 8) + static_cast<unsigned int>(sumScalar(items, n, i));
+}
+
+AVX2_CODE static double sumAvx2(const double *items, size_t n)
+{
+  __m256d acc = _mm256_setzero_pd();
+  size_t i = 0;
+  for (; i+4 <= n; i += 4)
+    acc = _mm256_add_pd(acc, _mm256_loadu_pd(items+i));
+  double lanes[4];
+  _mm256_storeu_pd(lanes, acc);
+  return (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]) + sumScalar(items, n, i);
+}
+
+AVX2_CODE static int dotAvx2(const int *a, const int *b, size_t n)
+{
+  __m256i acc = _mm256_setzero_si256();
+  size_t i = 0;
+  for (; i+8 <= n; i += 8)
+    acc = _mm256_add_epi32(acc, _mm256_mullo_epi32(
+          _mm256_loadu_si256(reinterpret_cast<const __m256i *>(a+i)),
+          _mm256_loadu_si256(reinterpret_cast<const __m256i *>(b+i))));
+  int lanes[8];
+  _mm256_storeu_si256(reinterpret_cast<__m256i *>(lanes), acc);
+  return sumScalar(lanes, 8) + static_cast<unsigned int>(dotScalar(a, b, n, i));
+}
+
+AVX2_CODE static double dotAvx2(const double *a, const double *b, size_t n)
+{
+  __m256d acc = _mm256_setzero_pd();
+  size_t i = 0;
+  for (; i+4 <= n; i += 4)
+    acc = _mm256_add_pd(acc, _mm256_mul_pd(_mm256_loadu_pd(a+i), _mm256_loadu_pd(b+i)));
+  double lanes[4];
+  _mm256_storeu_pd(lanes, acc);
+  return (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]) + dotScalar(a, b, n, i);
+}
+
+AVX2_CODE static void minmaxAvx2(const int *items, size_t n, int &min, int &max)
+{
+  __m256i lo = _mm256_set1_epi32(items[0]);
+  __m256i hi = lo;
+  size_t i = 0;
+  for (; i+8 <= n; i += 8)
+  {
+    __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(items+i));
+    lo = _mm256_min_epi32(lo, v);
+    hi = _mm256_max_epi32(hi, v);
+  }
+  int los[8], his[8];
+  _mm256_storeu_si256(reinterpret_cast<__m256i *>(los), lo);
+  _mm256_storeu_si256(reinterpret_cast<__m256i *>(his), hi);
+  minmaxScalar(los, 8, min, max);
+  widen(his, 0, 8, min, max);
+  widen(items, i, n, min, max);
+}
+
+AVX2_CODE static void minmaxAvx2(const double *items, size_t n, double &min, double &max)
+{
+  __m256d lo = _mm256_set1_pd(items[0]);
+  __m256d hi = lo;
+  size_t i = 0;
+  for (; i+4 <= n; i += 4)
+  {
+    __m256d v = _mm256_loadu_pd(items+i);
+    lo = _mm256_min_pd(lo, v);
+    hi = _mm256_max_pd(hi, v);
+  }
+  double los[4], his[4];
+  _mm256_storeu_pd(los, lo);
+  _mm256_storeu_pd(his, hi);
+  minmaxScalar(los, 4, min, max);
+  widen(his, 0, 4, min, max);
+  widen(items, i, n, min, max);
+}
+
+AVX2_CODE static void scaleAvx2(int *items, size_t n, int x)
+{
+  __m256i v = _mm256_set1_epi32(x);
+  size_t i = 0;
+  for (; i+8 <= n; i += 8)
+  {
+    __m256i *p = reinterpret_cast<__m256i *>(items+i);
+    _mm256_storeu_si256(p, _mm256_mullo_epi32(_mm256_loadu_si256(p), v));
+  }
+  scaleScalar(items, n, x, i);
+}
+
+AVX2_CODE static void scaleAvx2(double *items, size_t n, double x)
+{
+  __m256d v = _mm256_set1_pd(x);
+  size_t i = 0;
+  for (; i+4 <= n; i += 4)
+    _mm256_storeu_pd(items+i, _mm256_mul_pd(_mm256_loadu_pd(items+i), v));
+  scaleScalar(items, n, x, i);
+}
+
+AVX2_CODE static void axpyAvx2(int alpha, const int *x, int *y, size_t n)
+{
+  __m256i a = _mm256_set1_epi32(alpha);
+  size_t i = 0;
+  for (; i+8 <= n; i += 8)
+  {
+    __m256i *p = reinterpret_cast<__m256i *>(y+i);
+    __m256i v = _mm256_mullo_epi32(a, _mm256_loadu_si256(reinterpret_cast<const __m256i *>(x+i)));
+    _mm256_storeu_si256(p, _mm256_add_epi32(v, _mm256_loadu_si256(p)));
+  }
+  axpyScalar(alpha, x, y, n, i);
+}
+
+// No fused multiply-add: results stay those of the scalar code
+AVX2_CODE static void axpyAvx2(double alpha, const double *x, double *y, size_t n)
+{
+  __m256d a = _mm256_set1_pd(alpha);
+  size_t i = 0;
+  for (; i+4 <= n; i += 4)
+    _mm256_storeu_pd(y+i, _mm256_add_pd(_mm256_mul_pd(a, _mm256_loadu_pd(x+i)),
+                                        _mm256_loadu_pd(y+i)));
+  axpyScalar(alpha, x, y, n, i);
+}
+
+AVX2_CODE static size_t findAvx2(const int *items, size_t n, int x)
+{
+  __m256i v = _mm256_set1_epi32(x);
+  size_t i = 0;
+  for (; i+8 <= n; i += 8)
+  {
+    __m256i eq = _mm256_cmpeq_epi32(_mm256_loadu_si256(reinterpret_cast<const __m256i *>(items+i)), v);
+    int mask = _mm256_movemask_epi8(eq);
+    if (mask != 0)
+      return i + __builtin_ctz(mask) / 4;
+  }
+  return findScalar(items, n, x, i);
+}
+
+AVX2_CODE static size_t findAvx2(const double *items, size_t n, double x)
+{
+  __m256d v = _mm256_set1_pd(x);
+  size_t i = 0;
+  for (; i+4 <= n; i += 4)
+  {
+    int mask = _mm256_movemask_pd(_mm256_cmp_pd(_mm256_loadu_pd(items+i), v, _CMP_EQ_OQ));
+    if (mask != 0)
+      return i + __builtin_ctz(mask);
+  }
+  return findScalar(items, n, x, i);
+}
+
+#define DISPATCH(_NAME, _ARGS) \
+  switch (level()) \
+  { \
+    case AVX2: return _NAME##Avx2 _ARGS; \
+    case SSE2: return _NAME##Sse2 _ARGS; \
+    default:   return _NAME##Scalar _ARGS; \
+  }
+
+#else
+
+#define DISPATCH(_NAME, _ARGS) \
+  return _NAME##Scalar _ARGS;
+
+#endif // X86_KERNELS
+
+
+void ArrayKernels::fill(int *items, size_t n, int x)
+{
+  DISPATCH(fill, (items, n, x))
+}
+
+void ArrayKernels::fill(double *items, size_t n, double x)
+{
+  DISPATCH(fill, (items, n, x))
+}
+
+int ArrayKernels::sum(const int *items, size_t n)
+{
+  DISPATCH(sum, (items, n))
+}
+
+double ArrayKernels::sum(const double *items, size_t n)
+{
+  DISPATCH(sum, (items, n))
+}
+
+int ArrayKernels::dot(const int *a, const int *b, size_t n)
+{
+  DISPATCH(dot, (a, b, n))
+}
+
+double ArrayKernels::dot(const double *a, const double *b, size_t n)
+{
+  DISPATCH(dot, (a, b, n))
+}
+
+void ArrayKernels::minmax(const int *items, size_t n, int &min, int &max)
+{
+  DISPATCH(minmax, (items, n, min, max))
+}
+
+void ArrayKernels::minmax(const double *items, size_t n, double &min, double &max)
+{
+  DISPATCH(minmax, (items, n, min, max))
+}
+
+void ArrayKernels::scale(int *items, size_t n, int x)
+{
+  DISPATCH(scale, (items, n, x))
+}
+
+void ArrayKernels::scale(double *items, size_t n, double x)
+{
+  DISPATCH(scale, (items, n, x))
+}
+
+void ArrayKernels::axpy(int alpha, const int *x, int *y, size_t n)
+{
+  DISPATCH(axpy, (alpha, x, y, n))
+}
+
+void ArrayKernels::axpy(double alpha, const double *x, double *y, size_t n)
+{
+  DISPATCH(axpy, (alpha, x, y, n))
+}
+
+size_t ArrayKernels::find(const int *items, size_t n, int x)
+{
+  DISPATCH(find, (items, n, x))
+}
+
+size_t ArrayKernels::find(const double *items, size_t n, double x)
+{
+  DISPATCH(find, (items, n, x))
+}
+
+
+// Elementwise arithmetic
+
+static inline int plus(int a, int b) { return static_cast<unsigned int>(a) + b; }
+static inline int minus(int a, int b) { return static_cast<unsigned int>(a) - b; }
+static inline int times(int a, int b) { return static_cast<unsigned int>(a) * b; }
+static inline int divide(int a, int b) { return a / b; }
+static inline double plus(double a, double b) { return a + b; }
+static inline double minus(double a, double b) { return a - b; }
+static inline double times(double a, double b) { return a * b; }
+static inline double divide(double a, double b) { return a / b; }
+
+struct Plus { template<class T> T operator ()(T a, T b) const { return plus(a, b); } };
+struct Minus { template<class T> T operator ()(T a, T b) const { return minus(a, b); } };
+struct Times { template<class T> T operator ()(T a, T b) const { return times(a, b); } };
+struct Divide { template<class T> T operator ()(T a, T b) const { return divide(a, b); } };
+
+template<class F>
+struct Swapped
+{
+  template<class T> T operator ()(T a, T b) const { return F()(b, a); }
+};
+
+template<class T, class F>
+static void mapBase(const T *a, const T *b, T *out, size_t n, F f)
+{
+  for (size_t i=0; i<n; i++)
+    out[i] = f(a[i], b[i]);
+}
+
+template<class T, class F>
+static void mapBase(const T *a, T x, T *out, size_t n, F f)
+{
+  for (size_t i=0; i<n; i++)
+    out[i] = f(a[i], x);
+}
+
+#ifdef X86_KERNELS
+
+template<class T, class F>
+AVX2_CODE static void mapAvx2(const T *a, const T *b, T *out, size_t n, F f)
+{
+  for (size_t i=0; i<n; i++)
+    out[i] = f(a[i], b[i]);
+}
+
+template<class T, class F>
+AVX2_CODE static void mapAvx2(const T *a, T x, T *out, size_t n, F f)
+{
+  for (size_t i=0; i<n; i++)
+    out[i] = f(a[i], x);
+}
+
+#endif // X86_KERNELS
+
+// B is an array or a single item
+template<class T, class B, class F>
+static void mapWith(const T *a, B b, T *out, size_t n, F f)
+{
+#ifdef X86_KERNELS
+  if (ArrayKernels::level() == ArrayKernels::AVX2)
+  {
+    mapAvx2(a, b, out, n, f);
+    return;
+  }
+#endif
+  mapBase(a, b, out, n, f);
+}
+
+template<class T>
+static void mapItems(ArrayKernels::Op op, const T *a, const T *b, T *out, size_t n)
+{
+  switch (op)
+  {
+    case ArrayKernels::Add: mapWith(a, b, out, n, Plus()); break;
+    case ArrayKernels::Sub: mapWith(a, b, out, n, Minus()); break;
+    case ArrayKernels::Mul: mapWith(a, b, out, n, Times()); break;
+    case ArrayKernels::Div: mapWith(a, b, out, n, Divide()); break;
+  }
+}
+
+template<class T>
+static void mapItems(ArrayKernels::Op op, const T *a, T x, bool swapped, T *out, size_t n)
+{
+  switch (op)
+  {
+    case ArrayKernels::Add: 
+      mapWith(a, x, out, n, Plus()); 
+      break;
+    case ArrayKernels::Sub: 
+      if (swapped)
+        mapWith(a, x, out, n, Swapped<Minus>());
+      else
+        mapWith(a, x, out, n, Minus());
+      break;
+    case ArrayKernels::Mul: 
+      mapWith(a, x, out, n, Times()); 
+      break;
+    case ArrayKernels::Div: 
+      if (swapped)
+        mapWith(a, x, out, n, Swapped<Divide>());
+      else
+        mapWith(a, x, out, n, Divide());
+      break;
+  }
+}
+
+void ArrayKernels::map(Op op, const int *a, const int *b, int *out, size_t n)
+{
+  mapItems(op, a, b, out, n);
+}
+
+void ArrayKernels::map(Op op, const double *a, const double *b, double *out, size_t n)
+{
+  mapItems(op, a, b, out, n);
+}
+
+void ArrayKernels::map(Op op, const int *a, int x, bool swapped, int *out, size_t n)
+{
+  mapItems(op, a, x, swapped, out, n);
+}
+
+void ArrayKernels::map(Op op, const double *a, double x, bool swapped, double *out, size_t n)
+{
+  mapItems(op, a, x, swapped, out, n);
+}
+
+void ArrayKernels::widen(const int *a, double *out, size_t n)
+{
+  for (size_t i=0; i<n; i++)
+    out[i] = a[i];
+}
+
+
+// Bitsets
+
+static size_t countScalar(const uint64_t *words, size_t n)
+{
+  size_t count = 0;
+  for (size_t i=0; i<n; i++)
+    count += __builtin_popcountll(words[i]);
+  return count;
+}
+
+#ifdef X86_KERNELS
+
+__attribute__((target("popcnt"))) static size_t countPopcnt(const uint64_t *words, size_t n)
+{
+  size_t count = 0;
+  for (size_t i=0; i<n; i++)
+    count += __builtin_popcountll(words[i]);
+  return count;
+}
+
+static bool hasPopcnt()
+{
+  __builtin_cpu_init();
+  return __builtin_cpu_supports("popcnt");
+}
+
+#endif // X86_KERNELS
+
+size_t ArrayKernels::count(const uint64_t *words, size_t n)
+{
+#ifdef X86_KERNELS
+  static bool popcnt = hasPopcnt();
+  if (popcnt && level() != Scalar)
+    return countPopcnt(words, n);
+#endif
+  return countScalar(words, n);
+}
+
+size_t ArrayKernels::next(const uint64_t *words, size_t n, size_t bit)
+{
+  size_t i = bit/64;
+  if (i >= n)
+    return 64*n;
+  // Bits below bit masked off the first word
+  uint64_t word = words[i] & (~uint64_t(0) << bit%64);
+  while (word == 0)
+  {
+    if (++i == n)
+      return 64*n;
+    word = words[i];
+  }
+  return 64*i + __builtin_ctzll(word);
+}
+
+struct BitAnd { uint64_t operator ()(uint64_t a, uint64_t b) const { return a & b; } };
+struct BitOr { uint64_t operator ()(uint64_t a, uint64_t b) const { return a | b; } };
+struct BitXor { uint64_t operator ()(uint64_t a, uint64_t b) const { return a ^ b; } };
+
+void ArrayKernels::combine(BitOp op, const uint64_t *a, const uint64_t *b, uint64_t *out, size_t n)
+{
+  switch (op)
+  {
+    case And: mapWith(a, b, out, n, BitAnd()); break;
+    case Or: mapWith(a, b, out, n, BitOr()); break;
+    case Xor: mapWith(a, b, out, n, BitXor()); break;
+  }
+}
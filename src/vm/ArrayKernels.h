@@ -0,0 +1,68 @@
+#ifndef ARRAYKERNELS_H
+#define ARRAYKERNELS_H
+
+#include <cstddef>
+#include <stdint.h>
+
+/**
+ * Bulk operations over packed array items.
+ *
+ * Each runs the widest vector code the CPU supports: AVX2 or SSE2 on
+ * x86, scalar code elsewhere. MSL_SIMD=sse2 or MSL_SIMD=scalar lowers
+ * the level, for testing and comparison.
+ *
+ * Int arithmetic wraps around as in the executor. Real sums and dot
+ * products are added up in vector lanes, so they may differ in the
+ * last bits from a sum taken in order.
+ *
+ * Elementwise arithmetic (map) is left to the compiler to vectorize,
+ * built for AVX2 as well as for the baseline.
+ *
+ * Bitsets are arrays of 64-bit words. Bits are counted with popcnt
+ * where the CPU has it, above the scalar level, and searched with ctz.
+ */
+class ArrayKernels
+{
+  public:
+    enum Level { Scalar, SSE2, AVX2 };
+    enum Op { Add, Sub, Mul, Div };
+    enum BitOp { And, Or, Xor };
+
+    static Level level();
+    static const char *levelName();
+
+    static void fill(int *items, size_t n, int x);
+    static void fill(double *items, size_t n, double x);
+    static int sum(const int *items, size_t n);
+    static double sum(const double *items, size_t n);
+    static int dot(const int *a, const int *b, size_t n);
+    static double dot(const double *a, const double *b, size_t n);
+    // n > 0
+    static void minmax(const int *items, size_t n, int &min, int &max);
+    static void minmax(const double *items, size_t n, double &min, double &max);
+    static void scale(int *items, size_t n, int x);
+    static void scale(double *items, size_t n, double x);
+    // y = alpha*x + y
+    static void axpy(int alpha, const int *x, int *y, size_t n);
+    static void axpy(double alpha, const double *x, double *y, size_t n);
+    // Position of the first item equal to x, n if none
+    static size_t find(const int *items, size_t n, int x);
+    static size_t find(const double *items, size_t n, double x);
+
+    // out = a op b, item by item; out may be a or b
+    static void map(Op op, const int *a, const int *b, int *out, size_t n);
+    static void map(Op op, const double *a, const double *b, double *out, size_t n);
+    // out = a op x, or x op a when swapped
+    static void map(Op op, const int *a, int x, bool swapped, int *out, size_t n);
+    static void map(Op op, const double *a, double x, bool swapped, double *out, size_t n);
+    static void widen(const int *a, double *out, size_t n);
+
+    // Bits set in n words
+    static size_t count(const uint64_t *words, size_t n);
+    // Position of the first bit set from bit on, 64*n if none
+    static size_t next(const uint64_t *words, size_t n, size_t bit);
+    // out = a op b, word by word; out may be a or b
+    static void combine(BitOp op, const uint64_t *a, const uint64_t *b, uint64_t *out, size_t n);
+};
+
+#endif // ARRAYKERNELS_H
@@ -1,76 +1,1152 @@
+#include <cstring>
+#include <climits>
 #include "ArrayStorage.h"
+#include "Allocator.h"
+
+// Values need no destruction
+static void *allocBytes(size_t bytes)
+{
+  return Allocator::instance()->allocate(bytes);
+}
+
+static Value *allocItems(size_t size)
+{
+  return static_cast<Value *>(allocBytes(size * sizeof(Value)));
+}
+
+static void freeItems(void *items, size_t bytes)
+{
+  Allocator::instance()->deallocate(items, bytes);
+}
 
 ArrayStorage::ArrayStorage()
+  : m_allocs(0), m_frees(0), m_clones(0), m_unshares(0), 
+    m_bytesInUse(0), m_bytesAllocated(0), m_peakBytes(0), m_limit(0), m_reclaimer(NULL),
+    m_phase(Idle), m_scanPos(0), m_scanning(false), m_sweepPos(0),
+    m_nursery(allocItems(NurseryItems)), m_nurseryTop(0), m_nurseryFull(false),
+    m_nurseryBytes(0), m_promotedBytes(0), m_region(NULL), m_regionTop(0), m_shrunk(false)
 {
 }
 
 ArrayStorage::~ArrayStorage()
 {
-  for (size_t i=0; i<m_arrays.size(); i++)
-    delete m_arrays[i];
+  for (size_t i=0; i<m_slots.size(); i++)
+  {
+    Slot &slot = m_slots[i];
+    bool last = true;
+    if (slot.share != NULL && --slot.share->count > 0)
+      last = false;
+    else
+      delete slot.share;
+    delete[] slot.dims;
+    if ((slot.space == Old || (slot.space == Region && !inRegionStack(slot))) && last)
+      freeItems(slot.items, slot.bytes());
+  }
+  freeItems(m_nursery, NurseryItems * sizeof(Value));
+  if (m_region != NULL)
+    freeItems(m_region, RegionItems * sizeof(Value));
 }
 
 
-Value ArrayStorage::alloc(int size)
+Value ArrayStorage::alloc(int size, Kind kind)
 {
   if (size < 0)
     throw BadSize();
+  if (kind == Sparse)
+    return allocTable(Value::Array, Sparse, size);
+  reserve(arrayBytes(size, kind), Value());
+  return kind == Boxed? allocate(size) : allocPacked(size, kind);
+}
+
+Value ArrayStorage::alloc(const int *dims, size_t rank, Kind kind)
+{
+  Value ref = alloc(shapeSize(dims, rank), kind);
+  setDims(m_slots[ref.handle()], dims, rank);
+  return ref;
+}
+
+void ArrayStorage::reshape(const Value &ref, const int *dims, size_t rank)
+{
+  checkRef(ref);
+  Slot &slot = m_slots[ref.handle()];
+  if (shapeSize(dims, rank) != static_cast<int>(slot.size))
+    throw SizeMismatch();
+  setDims(slot, dims, rank);
+}
+
+void ArrayStorage::reshapeLike(const Value &ref, const Value &like)
+{
+  checkRef(like);
+  const Slot &slot = m_slots[like.handle()];
+  if (slot.dims != NULL)
+    reshape(ref, slot.dims, slot.rank);
+  else if (size(ref) != slot.size)
+    throw SizeMismatch();
+}
+
+bool ArrayStorage::sameShape(const Value &a, const Value &b) const
+{
+  if (rank(a) != rank(b))
+    return false;
+  for (size_t d=0; d<rank(a); d++)
+    if (extent(a, d) != extent(b, d))
+      return false;
+  return true;
+}
+
+int ArrayStorage::shapeSize(const int *dims, size_t rank)
+{
+  if (rank == 0 || rank > MaxRank)
+    throw BadSize();
+  long size = 1;
+  for (size_t i=0; i<rank; i++)
+  {
+    if (dims[i] < 0)
+      throw BadSize();
+    size *= dims[i];
+    if (size > INT_MAX)
+      throw BadSize();
+  }
+  return static_cast<int>(size);
+}
+
+void ArrayStorage::setDims(Slot &slot, const int *dims, size_t rank)
+{
+  delete[] slot.dims;
+  slot.dims = NULL;
+  slot.rank = rank;
+  if (rank > 1)
+  {
+    slot.dims = new int[rank];
+    memcpy(slot.dims, dims, rank * sizeof(int));
+  }
+}
 
-  size_t pos = m_arrays.size();
-  Vector<Value> *new_val = new Vector<Value>(size);
+Value ArrayStorage::allocate(size_t size)
+{
+  m_allocs++;
+  unsigned int pos = newSlot();
+  Slot &slot = m_slots[pos];
+  slot.size = slot.capacity = size;
+  if (slot.size <= LargeArray && m_nurseryTop + slot.size <= NurseryItems)
+  {
+    slot.space = Young;
+    slot.items = m_nursery + m_nurseryTop;
+    for (size_t i=0; i<slot.size; i++)
+      slot.items[i] = Value();
+    m_nurseryTop += slot.size;
+    m_nurseryBytes += arrayBytes(slot.size);
+    m_young.push_back(pos);
+  }
+  else
+  {
+    // Too large, or the nursery needs a minor collection first
+    if (slot.size <= LargeArray)
+      m_nurseryFull = true;
+    slot.space = Old;
+    slot.items = allocItems(slot.size);
+    for (size_t i=0; i<slot.size; i++)
+      slot.items[i] = Value();
+    m_bytesInUse += arrayBytes(slot.size);
+    m_bytesAllocated += arrayBytes(slot.size);
+  }
+  updatePeak();
+  return Value(Value::Array, pos, slot.generation);
+}
 
-  // Find empty space
-  for (size_t i=0; i<m_arrays.size(); i++)
-    if (m_arrays[i] == NULL)
-      pos = i; 
+// Packed items are never young: the nursery holds values
+Value ArrayStorage::allocPacked(size_t size, Kind kind)
+{
+  m_allocs++;
+  unsigned int pos = newSlot();
+  Slot &slot = m_slots[pos];
+  slot.size = slot.capacity = size;
+  slot.kind = kind;
+  slot.space = Old;
+  slot.items = static_cast<Value *>(allocBytes(slot.bytes()));
+  if (kind == Ints)
+    for (size_t i=0; i<slot.size; i++)
+      slot.ints[i] = 0;
+  else if (kind == Reals)
+    for (size_t i=0; i<slot.size; i++)
+      slot.reals[i] = 0.0;
+  else
+    memset(slot.words, 0, slot.bytes());
+  m_bytesInUse += arrayBytes(slot.size, kind);
+  m_bytesAllocated += arrayBytes(slot.size, kind);
+  updatePeak();
+  return Value(Value::Array, pos, slot.generation);
+}
 
-  if (pos<m_arrays.size())
-    m_arrays[pos] = new_val;
+Value ArrayStorage::clone(const Value &ref)
+{
+  checkRef(ref);
+  if (m_slots[ref.handle()].space == Region)
+  {
+    // Copied at once: the region may go first
+    reserve(arrayBytes(size(ref)), ref);
+    Value copy = allocate(size(ref));
+    for (size_t i=0; i<size(ref); i++)
+      setUnchecked(copy, i+1, m_slots[ref.handle()].items[i]);
+    const Slot &orig = m_slots[ref.handle()];
+    setDims(m_slots[copy.handle()], orig.dims, orig.rank);
+    return copy;
+  }
+  reserve(arrayBytes(0), ref);
+  m_allocs++;
+  m_clones++;
+  unsigned int pos = newSlot();
+  Slot &slot = m_slots[pos];
+  Slot &orig = m_slots[ref.handle()];
+  if (orig.share == NULL)
+    orig.share = new Share();
+  orig.share->count++;
+  slot.items = orig.items;
+  slot.size = orig.size;
+  slot.capacity = orig.capacity;
+  slot.share = orig.share;
+  slot.space = orig.space;
+  slot.kind = orig.kind;
+  setDims(slot, orig.dims, orig.rank);
+  // The items are counted once, by the original
+  if (slot.space == Young)
+  {
+    m_nurseryBytes += arrayBytes(0);
+    m_young.push_back(pos);
+  }
   else
-    m_arrays.push_back(new_val);
+  {
+    m_bytesInUse += arrayBytes(0);
+    m_bytesAllocated += arrayBytes(0);
+  }
+  updatePeak();
+  return Value(Value::Array, pos, slot.generation);
+}
 
-  return Value(Value::Array, pos);
+Value ArrayStorage::allocRegion(int size, size_t frame)
+{
+  if (size < 0)
+    throw BadSize();
+  reserve(arrayBytes(size), Value());
+
+  m_allocs++;
+  unsigned int pos = newSlot();
+  Slot &slot = m_slots[pos];
+  slot.size = slot.capacity = size;
+  slot.space = Region;
+  slot.frame = frame;
+  if (m_region == NULL)
+    m_region = allocItems(RegionItems);
+  m_regionTops.push_back(m_regionTop);
+  if (m_regionTop + slot.size <= RegionItems)
+  {
+    slot.items = m_region + m_regionTop;
+    m_regionTop += slot.size;
+  }
+  else
+  {
+    slot.items = allocItems(slot.size);
+    m_bytesInUse += arrayBytes(slot.size);
+  }
+  for (size_t i=0; i<slot.size; i++)
+    slot.items[i] = Value();
+  m_regionSlots.push_back(pos);
+  updatePeak();
+  return Value(Value::Array, pos, slot.generation);
+}
+
+void ArrayStorage::releaseRegion(size_t mark)
+{
+  while (m_regionSlots.size() > mark)
+  {
+    unsigned int pos = m_regionSlots[m_regionSlots.size()-1];
+    m_regionSlots.pop_back();
+    Slot &slot = m_slots[pos];
+    if (m_phase == Marking)
+      shadeItems(slot);
+    // The items may have grown out of the region stack
+    if (!inRegionStack(slot))
+    {
+      m_bytesInUse -= arrayBytes(slot.capacity);
+      freeItems(slot.items, slot.bytes());
+    }
+    m_regionTop = m_regionTops[m_regionTops.size()-1];
+    m_regionTops.pop_back();
+    m_frees++;
+    setDims(slot, NULL, 1);
+    slot.items = NULL;
+    slot.size = slot.capacity = 0;
+    slot.space = Free;
+    slot.generation++;
+    m_freeSlots.push_back(pos);
+  }
+}
+
+unsigned int ArrayStorage::newSlot()
+{
+  unsigned int pos;
+  if (!m_freeSlots.empty())
+  {
+    pos = m_freeSlots[m_freeSlots.size()-1];
+    m_freeSlots.pop_back();
+  }
+  else
+  {
+    pos = m_slots.size();
+    m_slots.push_back(Slot());
+  }
+  // Born black while marking, and so while sweeping where the sweep
+  // has yet to clear the mark. The items of a clone were reachable 
+  // from its original, and are marked through it.
+  m_slots[pos].marked = m_phase == Marking || (m_phase == Sweeping && pos >= m_sweepPos);
+  return pos;
 }
 
 void ArrayStorage::free(const Value &ref)
 {
   checkRef(ref);
-  delete m_arrays[ref.asArray()];
-  m_arrays[ref.asArray()] = NULL;
+  // The items may be the last references to arrays reachable when
+  // marking started
+  if (m_phase == Marking)
+    shadeItems(m_slots[ref.handle()]);
+  release(ref.handle());
+}
+
+// Frees the slot, returns the old space bytes freed
+size_t ArrayStorage::release(unsigned int pos)
+{
+  m_frees++;
+  Slot &slot = m_slots[pos];
+  size_t bytes = 0;
+  // Young items go with the nursery
+  bool last = slot.share == NULL || leaveShare(slot);
+  if (slot.space == Old)
+  {
+    bytes = arrayBytes(last? slot.capacity : 0, slot.kind);
+    m_bytesInUse -= bytes;
+    if (last)
+      freeItems(slot.items, slot.bytes());
+  }
+  setDims(slot, NULL, 1);
+  slot.items = NULL;
+  slot.size = slot.capacity = 0;
+  slot.space = Free;
+  slot.kind = Boxed;
+  slot.generation++;
+  m_freeSlots.push_back(pos);
+  return bytes;
+}
+
+// Drops the slot's count of its shared items, returns whether it was
+// the last one
+bool ArrayStorage::leaveShare(Slot &slot)
+{
+  Share *share = slot.share;
+  slot.share = NULL;
+  if (--share->count == 0)
+  {
+    delete share;
+    return true;
+  }
+  // Old items set to young arrays are remembered for the slot they
+  // were set through, which may be this one: the young arrays must
+  // outlive it for the slots left
+  if (slot.space == Old)
+    for (size_t i=0; i<tracedItems(slot); i++)
+      promote(slot.items[i]);
+  return false;
+}
+
+// Gives the array items of its own before storing keep to it
+void ArrayStorage::unshare(const Value &ref, const Value &keep)
+{
+  Slot &slot = m_slots[ref.handle()];
+  if (slot.share->count > 1)
+  {
+    // Collecting may leave the items promoted, or not shared any more
+    reserve(slot.bytes(), keep);
+    if (slot.share == NULL)
+      return;
+  }
+  if (slot.share->count == 1)
+  {
+    // The clones are gone already
+    delete slot.share;
+    slot.share = NULL;
+    return;
+  }
+  m_unshares++;
+  if (slot.space == Young && m_nurseryTop + slot.size > NurseryItems)
+  {
+    // No room left for a young copy
+    m_nurseryFull = true;
+    promote(ref);
+    return;
+  }
+
+  const Value *shared = slot.items;
+  leaveShare(slot);
+  // Tables are copied whole
+  if (!isTable(slot.kind))
+    slot.capacity = slot.size;
+  if (slot.space == Young)
+  {
+    slot.items = m_nursery + m_nurseryTop;
+    m_nurseryTop += slot.size;
+    m_nurseryBytes += arrayBytes(slot.size) - arrayBytes(0);
+  }
+  else
+  {
+    slot.items = static_cast<Value *>(allocBytes(slot.bytes()));
+    m_bytesInUse += arrayBytes(slot.capacity, slot.kind) - arrayBytes(0);
+    m_bytesAllocated += arrayBytes(slot.capacity, slot.kind) - arrayBytes(0);
+  }
+  if (slot.kind == Boxed || isTable(slot.kind))
+    for (size_t i=0; i<slot.capacity; i++)
+      slot.items[i] = shared[i];
+  else
+    memcpy(slot.items, shared, slot.bytes());
+  updatePeak();
+}
+
+void ArrayStorage::reserve(size_t bytes, const Value &keep)
+{
+  if (m_limit == 0 || liveBytes() + bytes <= m_limit)
+    return;
+  if (m_reclaimer != NULL)
+    m_reclaimer->reclaim(keep);
+  if (liveBytes() + bytes > m_limit)
+    throw HeapLimit();
 }
 
 
 void ArrayStorage::set(const Value &ref, const Value &index, const Value &val)
 {
   checkIndex(ref, index);
-  Vector<Value> *array = m_arrays[ref.asArray()];
-  (*array)[index.asInt()-1] = val;
+  Slot &slot = m_slots[ref.handle()];
+  if (slot.share != NULL)
+    unshare(ref, val);
+  if (slot.kind != Boxed)
+  {
+    if (slot.kind == Sparse)
+      setSparse(ref, index.asInt()-1, val);
+    else
+      setPacked(slot, index.asInt()-1, val);
+    return;
+  }
+  Value &item = slot.items[index.asInt()-1];
+  if (m_phase == Marking || val.type() == Value::Array)
+    barrier(slot, ref, index.asInt()-1, item, val);
+  item = val;
 }
 
 Value ArrayStorage::get(const Value &ref, const Value &index) const
 {
   checkIndex(ref, index);
-  return (*m_arrays[ref.asArray()])[index.asInt()-1];
+  return item(m_slots[ref.handle()], index.asInt()-1);
 }
 
-Vector<Value> *ArrayStorage::getArray(const Value &ref)
+void ArrayStorage::setPacked(Slot &slot, size_t index, const Value &val)
+{
+  if (slot.kind == Ints)
+  {
+    if (val.type() != Value::Int)
+      throw BadItem(Value::Int, val.type());
+    slot.ints[index] = val.asInt();
+  }
+  else if (slot.kind == Bits)
+  {
+    if (val.type() != Value::Bool)
+      throw BadItem(Value::Bool, val.type());
+    uint64_t bit = uint64_t(1) << index%64;
+    if (val.asBool())
+      slot.words[index/64] |= bit;
+    else
+      slot.words[index/64] &= ~bit;
+  }
+  else if (val.type() == Value::Real)
+    slot.reals[index] = val.asReal();
+  else if (val.type() == Value::Int)
+    slot.reals[index] = val.asInt();
+  else
+    throw BadItem(Value::Real, val.type());
+}
+
+void ArrayStorage::barrier(const Slot &slot, const Value &ref, size_t index,
+    const Value &item, const Value &val)
+{
+  if (m_phase == Marking)
+    shade(item);
+  if (!isLive(val))
+    return;
+  const Slot &stored = m_slots[val.handle()];
+  if (stored.space == Young && slot.space != Young)
+  {
+    m_remembered.push_back(Remembered(ref, index));
+    if (m_remembered.size() >= RememberedLimit)
+      m_nurseryFull = true;
+  }
+  else if (stored.space == Region && (slot.space != Region || slot.frame < stored.frame))
+    throw RegionEscape();
+}
+
+// Table keys of free and deleted entries
+static const Value::Type FreeKey = Value::TupOpen;
+static const Value::Type DeletedKey = Value::TupClose;
+// Smallest table, in entries
+static const size_t MinTable = 8;
+
+// Keys of different types differ even with the same bits. Mixed as
+// by the MurmurHash3 finalizer.
+static unsigned int hashKey(const Value &key)
+{
+  unsigned int h;
+  switch (key.type())
+  {
+    case Value::Int: h = key.asInt(); break;
+    case Value::String: h = key.asString(); break;
+    case Value::Bool: h = key.asBool(); break;
+    default: throw Value::TypeMismatch();
+  }
+  h ^= key.type() * 0x9e3779b9u;
+  h ^= h >> 16;
+  h *= 0x85ebca6bu;
+  h ^= h >> 13;
+  h *= 0xc2b2ae35u;
+  h ^= h >> 16;
+  return h;
+}
+
+static bool sameKey(const Value &a, const Value &b)
+{
+  if (a.type() != b.type())
+    return false;
+  switch (a.type())
+  {
+    case Value::Int: return a.asInt() == b.asInt();
+    case Value::String: return a.asString() == b.asString();
+    case Value::Bool: return a.asBool() == b.asBool();
+    default: return false;
+  }
+}
+
+// Entry of key in a table of capacity entries, or else the one to set
+// it in: the first deleted entry on the way, or the free one ending it
+static size_t probe(const Value *items, size_t capacity, const Value &key, bool &found)
+{
+  size_t mask = capacity - 1;
+  size_t pos = hashKey(key) & mask;
+  size_t deleted = capacity;
+  for (;; pos = (pos + 1) & mask)
+  {
+    const Value &k = items[2*pos];
+    if (k.type() == FreeKey)
+    {
+      found = false;
+      return deleted < capacity? deleted : pos;
+    }
+    if (k.type() == DeletedKey)
+    {
+      if (deleted == capacity)
+        deleted = pos;
+    }
+    else if (sameKey(k, key))
+    {
+      found = true;
+      return pos;
+    }
+  }
+}
+
+static void clearTable(Value *items, size_t capacity)
+{
+  for (size_t i=0; i<capacity; i++)
+  {
+    items[2*i] = Value(FreeKey);
+    items[2*i+1] = Value();
+  }
+}
+
+// A dictionary, or a sparse array of size items
+Value ArrayStorage::allocTable(Value::Type type, Kind kind, size_t size)
+{
+  reserve(arrayBytes(2*MinTable, kind), Value());
+  m_allocs++;
+  unsigned int pos = newSlot();
+  Slot &slot = m_slots[pos];
+  slot.size = size;
+  slot.capacity = 2*MinTable;
+  slot.kind = kind;
+  slot.space = Old;
+  slot.count = slot.used = 0;
+  slot.items = allocItems(slot.capacity);
+  clearTable(slot.items, MinTable);
+  m_bytesInUse += arrayBytes(slot.capacity, kind);
+  m_bytesAllocated += arrayBytes(slot.capacity, kind);
+  updatePeak();
+  return Value(type, pos, slot.generation);
+}
+
+Value ArrayStorage::allocDict()
+{
+  return allocTable(Value::Dict, Table, 0);
+}
+
+size_t ArrayStorage::dictSize(const Value &ref) const
+{
+  checkRef(ref, Value::Dict);
+  return m_slots[ref.handle()].count;
+}
+
+bool ArrayStorage::dictGet(const Value &ref, const Value &key, Value &val) const
+{
+  checkRef(ref, Value::Dict);
+  const Slot &slot = m_slots[ref.handle()];
+  bool found;
+  size_t pos = probe(slot.items, slot.capacity/2, key, found);
+  if (found)
+    val = slot.items[2*pos+1];
+  return found;
+}
+
+void ArrayStorage::dictSet(const Value &ref, const Value &key, const Value &val)
+{
+  checkRef(ref, Value::Dict);
+  setEntry(ref, key, val);
+}
+
+bool ArrayStorage::dictRemove(const Value &ref, const Value &key)
+{
+  checkRef(ref, Value::Dict);
+  return removeEntry(ref, key);
+}
+
+// Free entries are kept to a quarter of the table at least, so that
+// probes stay short and always end
+void ArrayStorage::setEntry(const Value &ref, const Value &key, const Value &val)
+{
+  Slot &slot = m_slots[ref.handle()];
+  bool found;
+  size_t pos = probe(slot.items, slot.capacity/2, key, found);
+  if (!found)
+  {
+    if ((slot.used + 1) * 4 > slot.capacity/2 * 3)
+    {
+      rehash(ref, val);
+      pos = probe(slot.items, slot.capacity/2, key, found);
+    }
+    if (slot.items[2*pos].type() == FreeKey)
+      slot.used++;
+    slot.count++;
+    slot.items[2*pos] = key;
+  }
+  storeValue(slot, ref, 2*pos+1, val);
+}
+
+bool ArrayStorage::removeEntry(const Value &ref, const Value &key)
+{
+  Slot &slot = m_slots[ref.handle()];
+  bool found;
+  size_t pos = probe(slot.items, slot.capacity/2, key, found);
+  if (found)
+    dropEntry(slot, pos);
+  return found;
+}
+
+void ArrayStorage::dropEntry(Slot &slot, size_t pos)
+{
+  if (m_phase == Marking)
+    shade(slot.items[2*pos+1]);
+  slot.items[2*pos] = Value(DeletedKey);
+  slot.items[2*pos+1] = Value();
+  slot.count--;
+}
+
+Value ArrayStorage::dictKeys(const Value &ref)
+{
+  checkRef(ref, Value::Dict);
+  size_t n = m_slots[ref.handle()].count;
+  reserve(arrayBytes(n), ref);
+  Value keys = allocate(n);
+  const Slot &slot = m_slots[ref.handle()];
+  // Keys are never arrays, and need no barrier
+  Value *items = m_slots[keys.handle()].items;
+  for (size_t i=0; i<slot.capacity; i+=2)
+    if (slot.items[i].type() != FreeKey && slot.items[i].type() != DeletedKey)
+      *items++ = slot.items[i];
+  return keys;
+}
+
+bool ArrayStorage::dictNext(const Value &ref, size_t &pos, Value &key, Value &val) const
+{
+  checkRef(ref, Value::Dict);
+  const Slot &slot = m_slots[ref.handle()];
+  for (; 2*pos < slot.capacity; pos++)
+  {
+    const Value &k = slot.items[2*pos];
+    if (k.type() != FreeKey && k.type() != DeletedKey)
+    {
+      key = k;
+      val = slot.items[2*pos+1];
+      return true;
+    }
+  }
+  return false;
+}
+
+// Moves the entries to a new table: twice as large, unless deleted
+// entries make most of the load
+void ArrayStorage::rehash(const Value &ref, const Value &keep)
+{
+  Slot &slot = m_slots[ref.handle()];
+  size_t capacity = slot.capacity/2;
+  if (slot.count * 2 >= capacity)
+    capacity *= 2;
+  reserve(2*capacity * sizeof(Value), keep);
+
+  // While marking, the old table may hold the last references to
+  // arrays reachable when marking started
+  if (m_phase == Marking)
+    shadeItems(slot);
+  Value *old = slot.items;
+  size_t oldSize = slot.capacity;
+  slot.items = allocItems(2*capacity);
+  slot.capacity = 2*capacity;
+  slot.used = slot.count;
+  clearTable(slot.items, capacity);
+  for (size_t i=0; i<oldSize; i+=2)
+  {
+    const Value &key = old[i];
+    if (key.type() == FreeKey || key.type() == DeletedKey)
+      continue;
+    bool found;
+    size_t pos = probe(slot.items, capacity, key, found);
+    slot.items[2*pos] = key;
+    // Young values are remembered at their new place
+    storeValue(slot, ref, 2*pos+1, old[i+1]);
+  }
+  freeItems(old, oldSize * sizeof(Value));
+  m_bytesInUse += (slot.capacity - oldSize) * sizeof(Value);
+  m_bytesAllocated += slot.capacity * sizeof(Value);
+  updatePeak();
+}
+
+Value ArrayStorage::sparseItem(const Slot &slot, size_t index)
+{
+  bool found;
+  size_t pos = probe(slot.items, slot.capacity/2, Value(static_cast<int>(index+1)), found);
+  return found? slot.items[2*pos+1] : Value();
+}
+
+// Zero is what items not set read, and is not kept
+void ArrayStorage::setSparse(const Value &ref, size_t index, const Value &val)
+{
+  Value key(static_cast<int>(index+1));
+  if (val.type() == Value::Int && val.asInt() == 0)
+    removeEntry(ref, key);
+  else
+    setEntry(ref, key, val);
+}
+
+ArrayStorage::Slot &ArrayStorage::growable(const Value &ref)
+{
+  checkRef(ref);
+  Slot &slot = m_slots[ref.handle()];
+  if (slot.dims != NULL)
+    throw BadSize();
+  return slot;
+}
+
+// Gives the array capacity items of its own, in the old space unless
+// it belongs to a region. The items stay where they were in the block,
+// as do remembered ones. Young items are promoted, their young arrays
+// with them at the next minor collection.
+void ArrayStorage::grow(const Value &ref, size_t capacity, const Value &keep)
+{
+  Slot &slot = m_slots[ref.handle()];
+  size_t bytes = itemsBytes(capacity, slot.kind);
+  reserve(bytes, keep);
+
+  Value *items = static_cast<Value *>(allocBytes(bytes));
+  if (slot.kind == Boxed)
+    for (size_t i=0; i<slot.size; i++)
+      items[i] = slot.items[i];
+  else
+  {
+    // Bits past the size stay clear
+    if (slot.kind == Bits)
+      memset(static_cast<void *>(items), 0, bytes);
+    memcpy(items, slot.items, itemsBytes(slot.size, slot.kind));
+  }
+
+  size_t added = arrayBytes(capacity, slot.kind);
+  if (slot.share != NULL)
+  {
+    leaveShare(slot);
+    if (slot.space == Old)
+      added -= arrayBytes(0);
+  }
+  else if (slot.space == Old || (slot.space == Region && !inRegionStack(slot)))
+  {
+    added -= arrayBytes(slot.capacity, slot.kind);
+    freeItems(slot.items, slot.bytes());
+  }
+  if (slot.space == Young)
+  {
+    slot.space = Old;
+    m_promotedBytes += arrayBytes(slot.size);
+    m_promoted.push_back(ref.handle());
+  }
+  slot.items = items;
+  slot.capacity = capacity;
+  m_bytesInUse += added;
+  m_bytesAllocated += bytes;
+  updatePeak();
+}
+
+// Clears items [first, last) of an unshared array
+void ArrayStorage::clearItems(Slot &slot, size_t first, size_t last)
+{
+  if (slot.kind == Sparse)
+  {
+    // Key by key, or over the table when that is shorter
+    if (last - first <= slot.capacity/2)
+    {
+      for (size_t i = first; i < last; i++)
+      {
+        bool found;
+        size_t pos = probe(slot.items, slot.capacity/2, Value(static_cast<int>(i+1)), found);
+        if (found)
+          dropEntry(slot, pos);
+      }
+      return;
+    }
+    for (size_t pos = 0; pos < slot.capacity/2; pos++)
+    {
+      const Value &key = slot.items[2*pos];
+      if (key.type() == Value::Int && static_cast<size_t>(key.asInt()) > first 
+          && static_cast<size_t>(key.asInt()) <= last)
+        dropEntry(slot, pos);
+    }
+    return;
+  }
+  for (size_t i = first; i < last; i++)
+    switch (slot.kind)
+    {
+      case Ints: slot.ints[i] = 0; break;
+      case Reals: slot.reals[i] = 0.0; break;
+      case Bits: slot.words[i/64] &= ~(uint64_t(1) << i%64); break;
+      default:
+        if (m_phase == Marking)
+          shade(slot.items[i]);
+        slot.items[i] = Value();
+    }
+}
+
+void ArrayStorage::push(const Value &ref, const Value &val)
+{
+  Slot &slot = growable(ref);
+  if (slot.size >= INT_MAX)
+    throw BadSize();
+  if (slot.kind != Sparse && (slot.share != NULL || slot.size == slot.capacity))
+  {
+    size_t capacity = slot.size < 4? 8 : 2*slot.size;
+    grow(ref, capacity < INT_MAX? capacity : INT_MAX, val);
+  }
+  // Counted only once stored, as it may be of the wrong type
+  setUnchecked(ref, slot.size+1, val);
+  slot.size++;
+}
+
+Value ArrayStorage::pop(const Value &ref)
+{
+  Slot &slot = growable(ref);
+  if (slot.size == 0)
+    throw BadIndex();
+  if (slot.share != NULL)
+    unshare(ref, Value());
+  Value last = item(slot, slot.size-1);
+  clearItems(slot, slot.size-1, slot.size);
+  slot.size--;
+  m_shrunk = true;
+  return last;
+}
+
+void ArrayStorage::resize(const Value &ref, int size)
+{
+  Slot &slot = growable(ref);
+  if (size < 0)
+    throw BadSize();
+  size_t n = size;
+  if (n > slot.capacity && slot.kind != Sparse)
+    grow(ref, n, Value());
+  else if (slot.share != NULL && n != slot.size)
+    unshare(ref, Value());
+  if (n < slot.size)
+  {
+    clearItems(slot, n, slot.size);
+    m_shrunk = true;
+  }
+  else
+    clearItems(slot, slot.size, n);
+  slot.size = n;
+}
+
+void ArrayStorage::reserveItems(const Value &ref, int capacity)
+{
+  Slot &slot = growable(ref);
+  if (capacity < 0)
+    throw BadSize();
+  // Sparse arrays need no room for items not set
+  if (static_cast<size_t>(capacity) > slot.capacity && slot.kind != Sparse)
+    grow(ref, capacity, Value());
+}
+
+size_t ArrayStorage::capacity(const Value &ref) const
+{
+  checkRef(ref);
+  return m_slots[ref.handle()].capacity;
+}
+
+bool ArrayStorage::inRange(const Value &ref, long first, long last) const
+{
+  if (ref.type() != Value::Array || !isLive(ref))
+    return false;
+  // An empty range needs no index at all
+  return first > last
+    || (first > 0 && static_cast<size_t>(last) <= m_slots[ref.handle()].size);
+}
+
+size_t ArrayStorage::size(const Value &ref) const
+{
+  checkRef(ref);
+  return m_slots[ref.handle()].size;
+}
+
+ArrayStorage::Kind ArrayStorage::kind(const Value &ref) const
+{
+  checkRef(ref);
+  Kind kind = m_slots[ref.handle()].kind;
+  return kind == Sparse? Boxed : kind;
+}
+
+size_t ArrayStorage::rank(const Value &ref) const
 {
   checkRef(ref);
-  return m_arrays[ref.asArray()];
+  return m_slots[ref.handle()].rank;
 }
 
-const Vector<Value> *ArrayStorage::getArray(const Value &ref) const
+size_t ArrayStorage::extent(const Value &ref, size_t dim) const
 {
   checkRef(ref);
-  return m_arrays[ref.asArray()];
+  const Slot &slot = m_slots[ref.handle()];
+  return slot.dims == NULL? slot.size : slot.dims[dim];
+}
+
+int ArrayStorage::cell(const Value &ref, const int *index, size_t rank) const
+{
+  checkRef(ref);
+  const Slot &slot = m_slots[ref.handle()];
+  if (rank != slot.rank)
+    throw BadIndex();
+  if (slot.dims == NULL)
+  {
+    if (index[0] <= 0 || static_cast<size_t>(index[0]) > slot.size)
+      throw BadIndex();
+    return index[0];
+  }
+  // Unsigned compare: an index below 1 wraps past every extent
+  int offset = 0;
+  for (size_t i=0; i<rank; i++)
+  {
+    if (static_cast<unsigned int>(index[i]) - 1u >= static_cast<unsigned int>(slot.dims[i]))
+      throw BadIndex();
+    offset = offset * slot.dims[i] + index[i] - 1;
+  }
+  return offset + 1;
+}
+
+int *ArrayStorage::writableInts(const Value &ref, const Value &keep)
+{
+  checkRef(ref);
+  if (m_slots[ref.handle()].share != NULL)
+    unshare(ref, keep);
+  return m_slots[ref.handle()].ints;
+}
+
+double *ArrayStorage::writableReals(const Value &ref, const Value &keep)
+{
+  checkRef(ref);
+  if (m_slots[ref.handle()].share != NULL)
+    unshare(ref, keep);
+  return m_slots[ref.handle()].reals;
+}
+
+uint64_t *ArrayStorage::writableWords(const Value &ref, const Value &keep)
+{
+  checkRef(ref);
+  if (m_slots[ref.handle()].share != NULL)
+    unshare(ref, keep);
+  return m_slots[ref.handle()].words;
+}
+
+size_t ArrayStorage::arrayBytes(size_t size, Kind kind)
+{
+  return sizeof(Slot) + itemsBytes(size, kind);
+}
+
+size_t ArrayStorage::itemsBytes(size_t size, Kind kind)
+{
+  switch (kind)
+  {
+    case Ints: return size * sizeof(int);
+    case Reals: return size * sizeof(double);
+    case Bits: return (size + 63) / 64 * sizeof(uint64_t);
+    default: return size * sizeof(Value);
+  }
+}
+
+void ArrayStorage::shadeItems(const Slot &slot)
+{
+  for (size_t i=0; i<tracedItems(slot); i++)
+    shade(slot.items[i]);
+}
+
+void ArrayStorage::startMarking()
+{
+  m_phase = Marking;
+  m_scanning = false;
+}
+
+void ArrayStorage::shade(const Value &ref)
+{
+  if (!isLive(ref) || m_slots[ref.handle()].marked)
+    return;
+  m_slots[ref.handle()].marked = true;
+  m_grey.push_back(ref);
+}
+
+bool ArrayStorage::trace(size_t budget)
+{
+  size_t work = 0;
+  while (work < budget && (m_scanning || !m_grey.empty()))
+  {
+    work++;
+    if (!m_scanning)
+    {
+      m_scan = m_grey[m_grey.size()-1];
+      m_grey.pop_back();
+      m_scanPos = 0;
+      m_scanning = true;
+    }
+    // Grey arrays may be freed on return from their frame
+    if (!isLive(m_scan))
+    {
+      m_scanning = false;
+      continue;
+    }
+    // Large arrays are traced over several slices
+    const Slot &slot = m_slots[m_scan.handle()];
+    size_t end = tracedItems(slot);
+    for (; m_scanPos < end && work < budget; m_scanPos++, work++)
+      shade(slot.items[m_scanPos]);
+    m_scanning = m_scanPos < end;
+  }
+  return !m_scanning && m_grey.empty();
+}
+
+void ArrayStorage::startSweeping()
+{
+  m_phase = Sweeping;
+  m_sweepPos = 0;
+}
+
+bool ArrayStorage::sweep(size_t budget, size_t &arrays, size_t &bytes)
+{
+  for (size_t work = 0; m_sweepPos < m_slots.size() && work < budget; m_sweepPos++, work++)
+  {
+    Slot &slot = m_slots[m_sweepPos];
+    // Region arrays go with their frame
+    if (slot.space != Free && slot.space != Region && !slot.marked)
+    {
+      arrays++;
+      bytes += release(m_sweepPos);
+    }
+    slot.marked = false;
+  }
+  if (m_sweepPos < m_slots.size())
+    return false;
+  m_phase = Idle;
+  return true;
+}
+
+void ArrayStorage::promote(const Value &ref)
+{
+  if (!isYoung(ref))
+    return;
+  Slot &slot = m_slots[ref.handle()];
+  Value *items = allocItems(slot.size);
+  for (size_t i=0; i<slot.size; i++)
+    items[i] = slot.items[i];
+  // Clones left young keep the nursery copy
+  if (slot.share != NULL)
+    leaveShare(slot);
+  slot.items = items;
+  slot.capacity = slot.size;
+  slot.space = Old;
+  m_bytesInUse += arrayBytes(slot.size);
+  m_bytesAllocated += arrayBytes(slot.size);
+  m_promotedBytes += arrayBytes(slot.size);
+  updatePeak();
+  m_promoted.push_back(ref.handle());
+}
+
+void ArrayStorage::finishMinor()
+{
+  // The remembered items may have been set again, popped or freed since
+  for (size_t i=0; i<m_remembered.size(); i++)
+  {
+    const Remembered &r = m_remembered[i];
+    if (!isLive(r.ref))
+      continue;
+    const Slot &slot = m_slots[r.ref.handle()];
+    if (r.index < tracedItems(slot))
+      promote(slot.items[r.index]);
+  }
+  m_remembered.clear();
+
+  while (!m_promoted.empty())
+  {
+    const Slot &slot = m_slots[m_promoted[m_promoted.size()-1]];
+    m_promoted.pop_back();
+    for (size_t i=0; i<slot.size; i++)
+      promote(slot.items[i]);
+  }
+
+  // Young arrays left are unreachable
+  for (size_t i=0; i<m_young.size(); i++)
+  {
+    if (m_slots[m_young[i]].space == Young)
+      release(m_young[i]);
+  }
+  m_young.clear();
+  m_nurseryTop = 0;
+  m_nurseryFull = false;
+}
+
+bool ArrayStorage::isLive(const Value &ref) const
+{
+  return (ref.type() == Value::Array || ref.type() == Value::Dict)
+      && ref.handle() < m_slots.size() 
+      && m_slots[ref.handle()].generation == ref.generation();
 }
 
-void ArrayStorage::checkRef(const Value &ref) const
+void ArrayStorage::checkRef(const Value &ref, Value::Type type) const
 {
-  if (ref.type() != Value::Array
-      || ref.asArray() >= m_arrays.size() 
-      || m_arrays[ref.asArray()] == NULL)
+  if (ref.type() != type || ref.handle() >= m_slots.size())
     throw BadRef();
+  if (m_slots[ref.handle()].generation != ref.generation())
+    throw StaleRef();
 }
 
 void ArrayStorage::checkIndex(const Value &ref, const Value &index) const
@@ -79,6 +1155,6 @@ void ArrayStorage::checkIndex(const Value &ref, const Value &index) const
   
   if (index.type() != Value::Int 
       || index.asInt() <= 0 
-      || static_cast<size_t>(index.asInt()) > m_arrays[ref.asArray()]->size())
+      || static_cast<size_t>(index.asInt()) > m_slots[ref.handle()].size)
     throw BadIndex();
 }
@@ -1,6 +1,7 @@
 #ifndef ARRAY_STORAGE_H
 #define ARRAY_STORAGE_H
 
+#include <stdint.h>
 #include "Value.h"
 #include "Vector.h"
 
@@ -8,6 +9,64 @@
  * An array store.
  * 
  * Does all dirty memory management behind the scene.
+ *
+ * Arrays live in slots. Freed slots are kept on a free list, so that
+ * both alloc and free take constant time. Each slot counts its
+ * generation, bumped when it is freed: a handle made for an older 
+ * generation is stale, and is rejected as a BadRef.
+ *
+ * Items of new arrays are bump-allocated in the nursery; arrays too
+ * large for it, or allocated when it is full, go to the old space.
+ * A minor collection promotes the young arrays still reachable to the
+ * old space, where their handles remain valid, and empties the 
+ * nursery. Items of old arrays set to young arrays are kept in the
+ * remembered set by set and setUnchecked, and are roots of the minor
+ * collection; when the set grows large, a minor collection is due.
+ *
+ * A clone shares the items of its array, counting the slots sharing
+ * them, until either is stored to: set and setUnchecked copy shared
+ * items first. Shared items are freed with the last slot sharing them.
+ *
+ * Region arrays belong to a call frame, and are released all at once
+ * with it, latest first: their items are bump-allocated from a region
+ * stack, or from the old space when it has no room. They are never 
+ * collected, but traced as any other. A region array may only be 
+ * stored to region arrays of its frame or later ones: other stores 
+ * throw RegionEscape.
+ *
+ * Typed arrays (Ints, Reals) keep their items packed as int and double,
+ * and take values of their own type only, as BadItem says otherwise; 
+ * Ints are widened for Reals arrays. Holding no arrays, they are never
+ * traced, and are allocated old. Bits arrays pack their items, Bools,
+ * as bits of 64-bit words, the bits past the size always clear.
+ *
+ * Arrays of rank 1 grow and shrink at the end, into spare capacity 
+ * past their size. Growth past it moves the items to a block twice as
+ * large, in the old space: handles stay valid, and appending takes
+ * amortized constant time. Shrinking clears the items dropped, and 
+ * sets shrunk() for good.
+ *
+ * Multi-dimensional arrays are one block of items in row-major order,
+ * with their extents kept by the slot: index [I, J] of an R x C array
+ * is item (I-1)*C + J. Each index is checked against its own extent.
+ * Other arrays have rank 1. Bulk operations see the items only.
+ *
+ * Dictionaries live in slots as well, with handles of type Dict. Their
+ * items are an open-addressing table of key and value pairs, probed
+ * linearly, which moves to a larger table as it fills: handles stay
+ * valid. Keys are Int, String or Bool values, others a TypeMismatch.
+ * Tables are allocated old, and traced as boxed items.
+ *
+ * Sparse arrays keep such a table too, keyed by index: only the items
+ * set are stored, and the others read as zero, which is never stored.
+ * Their footprint grows with the items set rather than their size. 
+ * Otherwise they are arrays of boxed items, and kind says Boxed.
+ *
+ * With a heap limit set, an allocation which would take the live 
+ * bytes (the old space and the nursery in use) past it first asks 
+ * the Reclaimer for a full collection, then throws HeapLimit if it 
+ * still does not fit. Promotions are never refused, and may pass the 
+ * limit until the next allocation.
  */
 class ArrayStorage 
 {
@@ -15,27 +74,337 @@ class ArrayStorage
     // Exceptions
     class Exception {};
     class BadSize: public Exception {};
+    class SizeMismatch: public BadSize {};
     class BadRef: public Exception {};
+    class StaleRef: public BadRef {};
     class BadIndex: public Exception {}; 
+    class HeapLimit: public Exception {};
+    class RegionEscape: public Exception {};
+    class BadItem: public Exception 
+    {
+      public:
+        BadItem(Value::Type expected, Value::Type found)
+          : m_expected(expected), m_found(found) {}
+        Value::Type expected() const { return m_expected; }
+        Value::Type found() const { return m_found; }
+      private:
+        Value::Type m_expected;
+        Value::Type m_found;
+    };
+
+    // What the items of an array hold; a Table is a dictionary's
+    enum Kind { Boxed, Ints, Reals, Bits, Table, Sparse };
+
+    // Frees what it can for an allocation over the heap limit. keep 
+    // is a value held outside the roots, such as an operand popped
+    // already.
+    class Reclaimer
+    {
+      public:
+        virtual ~Reclaimer() {}
+        virtual void reclaim(const Value &keep) = 0;
+    };
+
+    // Nursery capacity, in items
+    static const size_t NurseryItems = 1 << 15;
+    // Larger arrays are allocated old
+    static const size_t LargeArray = NurseryItems / 16;
+    // Remembered items making a minor collection due
+    static const size_t RememberedLimit = 1 << 12;
+    // Region stack capacity, in items
+    static const size_t RegionItems = 1 << 16;
+    // Largest number of dimensions
+    static const size_t MaxRank = 8;
 
     ArrayStorage();
     ~ArrayStorage();
 
-    Value alloc(int size);
+    Value alloc(int size, Kind kind = Boxed);
+    // An array of dims[0] x ... x dims[rank-1] items
+    Value alloc(const int *dims, size_t rank, Kind kind = Boxed);
+    // Give the items of ref dimensions of the same total size
+    void reshape(const Value &ref, const int *dims, size_t rank);
+    void reshapeLike(const Value &ref, const Value &like);
+    bool sameShape(const Value &a, const Value &b) const;
+    // Items of an array of the dimensions, BadSize if invalid
+    static int shapeSize(const int *dims, size_t rank);
+    // An array released by releaseRegion; frame is the depth of the
+    // frame it belongs to
+    Value allocRegion(int size, size_t frame);
+    // Release the region arrays allocated after regionMark was mark
+    size_t regionMark() const { return m_regionSlots.size(); }
+    void releaseRegion(size_t mark);
+    // Whether ref is a region array of frame or a later one
+    bool inRegion(const Value &ref, size_t frame) const
+      { return isLive(ref) && m_slots[ref.handle()].space == Region 
+          && m_slots[ref.handle()].frame >= frame; }
+    // A new array with the same items, copied on write. 
+    Value clone(const Value &ref);
     void free(const Value &ref);
 
     void set(const Value &ref, const Value &index, const Value &val);
     Value get(const Value &ref, const Value &index) const;
 
-    Vector<Value> *getArray(const Value &ref);
-    const Vector<Value> *getArray(const Value &ref) const;
+    // Access without the index check, for indices proven in range
+    void setUnchecked(const Value &ref, int index, const Value &val)
+    {
+      Slot &slot = m_slots[ref.asArray()];
+      if (slot.share != NULL)
+        unshare(ref, val);
+      if (slot.kind != Boxed)
+      {
+        if (slot.kind == Sparse)
+          setSparse(ref, index-1, val);
+        else
+          setPacked(slot, index-1, val);
+        return;
+      }
+      Value &item = slot.items[index-1];
+      if (m_phase == Marking || val.type() == Value::Array)
+        barrier(slot, ref, index-1, item, val);
+      item = val;
+    }
+    Value getUnchecked(const Value &ref, int index) const
+      { return item(m_slots[ref.asArray()], index-1); }
+    // Whether ref is an array and every index in [first, last] is valid
+    bool inRange(const Value &ref, long first, long last) const;
+
+    // Growable arrays, of rank 1 only (BadSize otherwise). New items are
+    // zero, as by alloc; pop throws BadIndex on an empty array.
+    void push(const Value &ref, const Value &val);
+    Value pop(const Value &ref);
+    void resize(const Value &ref, int size);
+    void reserveItems(const Value &ref, int capacity);
+    size_t capacity(const Value &ref) const;
+    // Whether any array has shrunk: sizes never get smaller otherwise
+    bool shrunk() const { return m_shrunk; }
+
+    size_t size(const Value &ref) const;
+    Kind kind(const Value &ref) const;
+    size_t rank(const Value &ref) const;
+    // Extent along dimension dim, from 0
+    size_t extent(const Value &ref, size_t dim) const;
+    // Item (from 1) at index[0], ..., index[rank-1]; BadIndex unless 
+    // the rank matches and every index is within its extent
+    int cell(const Value &ref, const int *index, size_t rank) const;
+    // Packed items of Ints and Reals arrays, for bulk access. Writing
+    // needs items of the array's own: the writable ones are copied 
+    // first when shared, keeping keep alive should that collect.
+    const int *ints(const Value &ref) const { return m_slots[ref.asArray()].ints; }
+    const double *reals(const Value &ref) const { return m_slots[ref.asArray()].reals; }
+    int *writableInts(const Value &ref, const Value &keep = Value());
+    double *writableReals(const Value &ref, const Value &keep = Value());
+    // Words of Bits arrays, item i (from 0) being bit i%64 of word i/64
+    const uint64_t *words(const Value &ref) const { return m_slots[ref.asArray()].words; }
+    uint64_t *writableWords(const Value &ref, const Value &keep = Value());
+
+    // Dictionaries
+    Value allocDict();
+    size_t dictSize(const Value &ref) const;
+    // Whether key is set, and its value in val if so
+    bool dictGet(const Value &ref, const Value &key, Value &val) const;
+    void dictSet(const Value &ref, const Value &key, const Value &val);
+    // Whether key was set
+    bool dictRemove(const Value &ref, const Value &key);
+    // The keys as a new array, in table order
+    Value dictKeys(const Value &ref);
+    // The first entry in table order from pos on, which pos is set to;
+    // false if none
+    bool dictNext(const Value &ref, size_t &pos, Value &key, Value &val) const;
+
+    // Whether ref is a handle of an array not freed yet
+    bool isLive(const Value &ref) const;
+
+    // Garbage collection support (see GarbageCollector).
+    //
+    // Arrays are white (unmarked), grey (marked, items not traced yet)
+    // or black (marked and traced). While marking, storing to an array
+    // shades the item overwritten: everything reachable when marking 
+    // started stays marked, and arrays allocated meanwhile are black.
+    // trace and sweep do at most budget units of work, and return 
+    // whether their phase is done; sweep adds what it frees to arrays 
+    // and bytes, and clears the marks.
+    enum Phase { Idle, Marking, Sweeping };
+    Phase phase() const { return m_phase; }
+    void startMarking();
+    void shade(const Value &ref);
+    bool trace(size_t budget);
+    void startSweeping();
+    bool sweep(size_t budget, size_t &arrays, size_t &bytes);
+    // Old space in use
+    size_t bytesInUse() const { return m_bytesInUse; }
+    // Bytes ever allocated to the old space, promotions included
+    size_t bytesAllocated() const { return m_bytesAllocated; }
+
+    // Minor collections: promote the young arrays reachable from each
+    // root, then finishMinor promotes what they and the remembered set 
+    // reach, frees the rest and empties the nursery
+    void promote(const Value &ref);
+    void finishMinor();
+    bool nurseryFull() const { return m_nurseryFull; }
+    size_t nurseryUsed() const { return m_nurseryTop; }
+
+    // Heap limit in bytes, 0 for none
+    void setLimit(size_t bytes) { m_limit = bytes; }
+    size_t limit() const { return m_limit; }
+    void setReclaimer(Reclaimer *reclaimer) { m_reclaimer = reclaimer; }
+    // The old space, and the nursery and the region stack in use
+    size_t liveBytes() const 
+      { return m_bytesInUse + (m_nurseryTop + m_regionTop) * sizeof(Value); }
+    size_t peakBytes() const { return m_peakBytes; }
+
+    // Approximate footprint of an array of size items
+    static size_t arrayBytes(size_t size, Kind kind = Boxed);
+    // Bytes taken by size items
+    static size_t itemsBytes(size_t size, Kind kind);
+
+    // Statistics
+    size_t allocCount() const { return m_allocs; }
+    size_t freeCount() const { return m_frees; }
+    size_t cloneCount() const { return m_clones; }
+    size_t unshareCount() const { return m_unshares; }
+    size_t nurseryBytes() const { return m_nurseryBytes; }
+    size_t promotedBytes() const { return m_promotedBytes; }
 
   private:
-    void checkRef(const Value &ref) const;
+    enum Space { Free, Young, Old, Region };
+
+    // Items shared by clones
+    struct Share
+    {
+      Share(): count(1) {}
+      size_t count;
+    };
+
+    struct Slot
+    {
+      Slot()
+        : items(NULL), size(0), capacity(0), share(NULL), dims(NULL), rank(1), count(0), used(0),
+          generation(0), frame(0), space(Free), kind(Boxed), marked(false) {}
+      size_t bytes() const { return itemsBytes(capacity, kind); }
+      union
+      {
+        Value *items;
+        int *ints;
+        double *reals;
+        uint64_t *words;
+      };
+      size_t size;
+      size_t capacity;  // Items allocated
+      Share *share;
+      int *dims;  // Extents of multi-dimensional arrays, else NULL
+      unsigned int rank;
+      unsigned int count; // Table entries
+      unsigned int used;  // Table entries, deleted ones included
+      unsigned int generation;
+      unsigned int frame; // Of region arrays
+      Space space;
+      Kind kind;
+      bool marked;
+    };
+
+    struct Remembered
+    {
+      Remembered(const Value &ref = Value(), size_t index = 0)
+        : ref(ref), index(index) {}
+      Value ref;
+      size_t index;
+    };
+
+    Value allocate(size_t size);
+    Value allocPacked(size_t size, Kind kind);
+    static Value item(const Slot &slot, size_t index)
+    {
+      switch (slot.kind)
+      {
+        case Boxed: return slot.items[index];
+        case Ints: return Value(slot.ints[index]);
+        case Reals: return Value(slot.reals[index]);
+        case Bits: return Value((slot.words[index/64] >> index%64 & 1) != 0);
+        default: return sparseItem(slot, index);
+      }
+    }
+    void setPacked(Slot &slot, size_t index, const Value &val);
+    static Value sparseItem(const Slot &slot, size_t index);
+    void setSparse(const Value &ref, size_t index, const Value &val);
+    static void setDims(Slot &slot, const int *dims, size_t rank);
+    unsigned int newSlot();
+    size_t release(unsigned int pos);
+    void unshare(const Value &ref, const Value &keep);
+    void reserve(size_t bytes, const Value &keep);
+    void updatePeak()
+    {
+      if (liveBytes() > m_peakBytes)
+        m_peakBytes = liveBytes();
+    }
+    bool leaveShare(Slot &slot);
+    void checkRef(const Value &ref, Value::Type type = Value::Array) const;
     void checkIndex(const Value &ref, const Value &index) const;
+    void barrier(const Slot &slot, const Value &ref, size_t index,
+        const Value &item, const Value &val);
+    void shadeItems(const Slot &slot);
+    static bool isTable(Kind kind) { return kind == Table || kind == Sparse; }
+    // Items which may hold arrays
+    static size_t tracedItems(const Slot &slot)
+    {
+      if (isTable(slot.kind))
+        return slot.capacity;
+      return slot.kind == Boxed? slot.size : 0;
+    }
+    void storeValue(Slot &slot, const Value &ref, size_t index, const Value &val)
+    {
+      Value &item = slot.items[index];
+      if (m_phase == Marking || val.type() == Value::Array)
+        barrier(slot, ref, index, item, val);
+      item = val;
+    }
+    // Tables of dictionaries and sparse arrays, of capacity/2 entries
+    Value allocTable(Value::Type type, Kind kind, size_t size);
+    void setEntry(const Value &ref, const Value &key, const Value &val);
+    bool removeEntry(const Value &ref, const Value &key);
+    void dropEntry(Slot &slot, size_t pos);
+    void rehash(const Value &ref, const Value &keep);
+    Slot &growable(const Value &ref);
+    void grow(const Value &ref, size_t capacity, const Value &keep);
+    void clearItems(Slot &slot, size_t first, size_t last);
+    bool inRegionStack(const Slot &slot) const
+      { return slot.items >= m_region && slot.items < m_region + RegionItems; }
+    bool isYoung(const Value &ref) const
+      { return isLive(ref) && m_slots[ref.handle()].space == Young; }
+
+    Vector<Slot> m_slots;
+    Vector<unsigned int> m_freeSlots;
+    size_t m_allocs;
+    size_t m_frees;
+    size_t m_clones;
+    size_t m_unshares;
+    size_t m_bytesInUse;
+    size_t m_bytesAllocated;
+    size_t m_peakBytes;
+    size_t m_limit;
+    Reclaimer *m_reclaimer;
+
+    Phase m_phase;
+    Vector<Value> m_grey;
+    Value m_scan;       // Grey array being traced
+    size_t m_scanPos;
+    bool m_scanning;
+    size_t m_sweepPos;  // Slots below are swept
 
-    Vector<Vector<Value> *> m_arrays;
+    Value *m_nursery;
+    size_t m_nurseryTop;
+    bool m_nurseryFull;
+    Vector<unsigned int> m_young;      // Slots allocated young
+    Vector<Remembered> m_remembered;   // Old items set to young arrays
+    Vector<unsigned int> m_promoted;   // Items not promoted yet
+    size_t m_nurseryBytes;
+    size_t m_promotedBytes;
+
+    Value *m_region;
+    size_t m_regionTop;
+    Vector<unsigned int> m_regionSlots; // In allocation order
+    Vector<size_t> m_regionTops;        // Before each allocation
+    bool m_shrunk;
 };
 
 #endif // ARRAY_STORAGE_H
-
@@ -1,10 +1,21 @@
 #include "BasicBuiltin.h"
+#include "Util.h"
 
 
 const ListedBuiltin::Definition BasicBuiltin::defs[] =
 {
   {"array", BasicBuiltin::array},
+  {"intarray", BasicBuiltin::intarray},
+  {"realarray", BasicBuiltin::realarray},
+  {"sparse", BasicBuiltin::sparse},
   {"size", BasicBuiltin::size},
+  {"shape", BasicBuiltin::shape},
+  {"clone", BasicBuiltin::clone},
+  {"push", BasicBuiltin::push},
+  {"pop", BasicBuiltin::pop},
+  {"resize", BasicBuiltin::resize},
+  {"reserve", BasicBuiltin::reserve},
+  {"local", BasicBuiltin::local},
   {"print", BasicBuiltin::print},
   {"println", BasicBuiltin::println},
 };
@@ -14,16 +25,118 @@ BasicBuiltin::BasicBuiltin(StringTable *strings)
 {
 }
 
+// Array sizes are N, or [N1, ..., Nk] for k dimensions. Gives the rank.
+static size_t popDims(Context &context, int *dims)
+{
+  if (context.stack.top().type() != Value::TupClose)
+  {
+    dims[0] = context.pop(Value::Int).asInt();
+    return 1;
+  }
+  context.pop();
+  size_t rank = 0;
+  while (context.stack.top().type() != Value::TupOpen)
+  {
+    if (rank == ArrayStorage::MaxRank)
+      throw ArrayStorage::BadSize();
+    dims[rank++] = context.pop(Value::Int).asInt();
+  }
+  context.pop();
+  for (size_t i=0; i<rank/2; i++)
+    swap(dims[i], dims[rank-1-i]);
+  return rank;
+}
+
 void BasicBuiltin::array(ListedBuiltin *, Context &context)
 {
-  Value size = context.pop(Value::Int);
-  context.push(context.arrays.alloc(size.asInt()));
+  int dims[ArrayStorage::MaxRank];
+  size_t rank = popDims(context, dims);
+  context.push(context.arrays.alloc(dims, rank));
+}
+
+void BasicBuiltin::intarray(ListedBuiltin *, Context &context)
+{
+  int dims[ArrayStorage::MaxRank];
+  size_t rank = popDims(context, dims);
+  context.push(context.arrays.alloc(dims, rank, ArrayStorage::Ints));
+}
+
+void BasicBuiltin::realarray(ListedBuiltin *, Context &context)
+{
+  int dims[ArrayStorage::MaxRank];
+  size_t rank = popDims(context, dims);
+  context.push(context.arrays.alloc(dims, rank, ArrayStorage::Reals));
+}
+
+void BasicBuiltin::sparse(ListedBuiltin *, Context &context)
+{
+  int dims[ArrayStorage::MaxRank];
+  size_t rank = popDims(context, dims);
+  context.push(context.arrays.alloc(dims, rank, ArrayStorage::Sparse));
+}
+
+void BasicBuiltin::local(ListedBuiltin *, Context &context)
+{
+  int dims[ArrayStorage::MaxRank];
+  size_t rank = popDims(context, dims);
+  Value ref = context.allocRegionArray(ArrayStorage::shapeSize(dims, rank));
+  context.arrays.reshape(ref, dims, rank);
+  context.push(ref);
 }
 
 void BasicBuiltin::size(ListedBuiltin *, Context &context)
+{
+  Value v = context.popValue();
+  if (v.type() == Value::Dict)
+  {
+    context.push(static_cast<int>(context.arrays.dictSize(v)));
+    return;
+  }
+  if (v.type() != Value::Array)
+    throw Context::BadType();
+  context.push(static_cast<int>(context.arrays.size(v)));
+}
+
+void BasicBuiltin::shape(ListedBuiltin *, Context &context)
+{
+  Value array = context.pop(Value::Array);
+  context.push(Value::TupOpen);
+  for (size_t d=0; d<context.arrays.rank(array); d++)
+    context.push(static_cast<int>(context.arrays.extent(array, d)));
+  context.push(Value::TupClose);
+}
+
+void BasicBuiltin::clone(ListedBuiltin *, Context &context)
+{
+  Value array = context.pop(Value::Array);
+  context.push(context.arrays.clone(array));
+}
+
+void BasicBuiltin::push(ListedBuiltin *, Context &context)
+{
+  CallArgs args(context, 2);
+  context.arrays.push(args.array(0), args[1]);
+  args.ret();
+}
+
+void BasicBuiltin::pop(ListedBuiltin *, Context &context)
 {
   Value array = context.pop(Value::Array);
-  context.push(static_cast<int>(context.arrays.getArray(array)->size()));
+  context.push(context.arrays.pop(array));
+}
+
+void BasicBuiltin::resize(ListedBuiltin *, Context &context)
+{
+  CallArgs args(context, 2);
+  context.arrays.resize(args.array(0), args[1].asInt());
+  args.ret();
+}
+
+void BasicBuiltin::reserve(ListedBuiltin *, Context &context)
+{
+  CallArgs args(context, 2);
+  context.arrays.reserveItems(args.array(0), args[1].asInt());
+  args.ret();
 }
 
 void BasicBuiltin::printValue(const Value &v, const Context &context, bool escape)
@@ -49,22 +162,57 @@ void BasicBuiltin::printValue(const Value &v, const Context &context, bool escap
         cout.printf("]");
         break;
       case Value::Array:
-      {
-        const Vector<Value> &items = *(context.arrays.getArray(v));
-        cout.printf("(");
-        for (size_t i=0; i<items.size(); i++)
-        {
-          if (i>0)
-            cout.printf(" ");
-          printValue(items[i], context, true);
-        }
-        cout.printf(")");
-      } break;
+        printItems(v, context, 0, 1);
+        break;
+      case Value::Dict:
+        printEntries(v, context);
+        break;
       default:
         break;
     }
 }
 
+// Multi-dimensional arrays print as nested rows. Prints the items
+// along dim, from the one at first.
+void BasicBuiltin::printItems(const Value &array, const Context &context, 
+    size_t dim, size_t first)
+{
+  const ArrayStorage &arrays = context.arrays;
+  size_t rank = arrays.rank(array);
+  size_t stride = 1;
+  for (size_t d = dim+1; d < rank; d++)
+    stride *= arrays.extent(array, d);
+  cout.printf("(");
+  for (size_t i=0; i<arrays.extent(array, dim); i++)
+  {
+    if (i>0)
+      cout.printf(" ");
+    if (dim+1 < rank)
+      printItems(array, context, dim+1, first + i*stride);
+    else
+      printValue(arrays.getUnchecked(array, first + i), context, true);
+  }
+  cout.printf(")");
+}
+
+// Dictionaries print as {K=V ...}, in table order
+void BasicBuiltin::printEntries(const Value &dict, const Context &context)
+{
+  cout.printf("{");
+  Value key, val;
+  bool first = true;
+  for (size_t pos = 0; context.arrays.dictNext(dict, pos, key, val); pos++)
+  {
+    if (!first)
+      cout.printf(" ");
+    first = false;
+    printValue(key, context, true);
+    cout.printf("=");
+    printValue(val, context, true);
+  }
+  cout.printf("}");
+}
+
 void BasicBuiltin::print(ListedBuiltin *, Context &context)
 {
   unsigned int level = 0;
@@ -14,9 +14,22 @@ class BasicBuiltin: public ListedBuiltin
 
   private:
     static void printValue(const Value &value, const Context &context, bool escape=false);
+    static void printEntries(const Value &dict, const Context &context);
+    static void printItems(const Value &array, const Context &context, 
+        size_t dim, size_t first);
 
     static void array(ListedBuiltin *self, Context &context);
+    static void intarray(ListedBuiltin *self, Context &context);
+    static void realarray(ListedBuiltin *self, Context &context);
+    static void sparse(ListedBuiltin *self, Context &context);
+    static void local(ListedBuiltin *self, Context &context);
     static void size(ListedBuiltin *self, Context &context);
+    static void shape(ListedBuiltin *self, Context &context);
+    static void clone(ListedBuiltin *self, Context &context);
+    static void push(ListedBuiltin *self, Context &context);
+    static void pop(ListedBuiltin *self, Context &context);
+    static void resize(ListedBuiltin *self, Context &context);
+    static void reserve(ListedBuiltin *self, Context &context);
     static void print(ListedBuiltin *self, Context &context);
     static void println(ListedBuiltin *self, Context &context);
     static void stackTrace(ListedBuiltin *self, Context &context);
@@ -0,0 +1,102 @@
+#include "BitsetBuiltin.h"
+#include "ArrayKernels.h"
+
+
+const ListedBuiltin::Definition BitsetBuiltin::defs[] =
+{
+  {"bitset", BitsetBuiltin::bitset},
+  {"bset", BitsetBuiltin::bset},
+  {"bclear", BitsetBuiltin::bclear},
+  {"btest", BitsetBuiltin::btest},
+  {"bcount", BitsetBuiltin::bcount},
+  {"bnext", BitsetBuiltin::bnext},
+  {"band", BitsetBuiltin::band},
+  {"bor", BitsetBuiltin::bor},
+  {"bxor", BitsetBuiltin::bxor},
+};
+
+BitsetBuiltin::BitsetBuiltin(StringTable *strings)
+  : ListedBuiltin(strings, defs, sizeof(defs)/sizeof(ListedBuiltin::Definition))
+{
+}
+
+static size_t wordCount(const ArrayStorage &arrays, const Value &b)
+{
+  return (arrays.size(b) + 63) / 64;
+}
+
+void BitsetBuiltin::bitset(ListedBuiltin *, Context &context)
+{
+  CallArgs args(context, 1);
+  args.ret(context.arrays.alloc(args[0].asInt(), ArrayStorage::Bits));
+}
+
+void BitsetBuiltin::bset(ListedBuiltin *, Context &context)
+{
+  CallArgs args(context, 2);
+  context.arrays.set(args.bitset(0), args[1], true);
+  args.ret();
+}
+
+void BitsetBuiltin::bclear(ListedBuiltin *, Context &context)
+{
+  CallArgs args(context, 2);
+  context.arrays.set(args.bitset(0), args[1], false);
+  args.ret();
+}
+
+void BitsetBuiltin::btest(ListedBuiltin *, Context &context)
+{
+  CallArgs args(context, 2);
+  args.ret(context.arrays.get(args.bitset(0), args[1]));
+}
+
+void BitsetBuiltin::bcount(ListedBuiltin *, Context &context)
+{
+  CallArgs args(context, 1);
+  const ArrayStorage &arrays = context.arrays;
+  Value b = args.bitset(0);
+  args.ret(static_cast<int>(ArrayKernels::count(arrays.words(b), wordCount(arrays, b))));
+}
+
+// Any I from 1 on, bits past the size being clear
+void BitsetBuiltin::bnext(ListedBuiltin *, Context &context)
+{
+  CallArgs args(context, 2);
+  const ArrayStorage &arrays = context.arrays;
+  Value b = args.bitset(0);
+  Value i = args[1];
+  if (i.type() != Value::Int || i.asInt() <= 0)
+    throw ArrayStorage::BadIndex();
+  size_t n = wordCount(arrays, b);
+  size_t pos = ArrayKernels::next(arrays.words(b), n, i.asInt() - 1);
+  args.ret(pos < 64*n? static_cast<int>(pos + 1) : 0);
+}
+
+static void combine(Context &context, ArrayKernels::BitOp op)
+{
+  CallArgs args(context, 2);
+  ArrayStorage &arrays = context.arrays;
+  Value a = args.bitset(0);
+  Value b = args.bitset(1);
+  if (arrays.size(a) != arrays.size(b))
+    throw ArrayStorage::SizeMismatch();
+  uint64_t *words = arrays.writableWords(a);
+  ArrayKernels::combine(op, words, arrays.words(b), words, wordCount(arrays, a));
+  args.ret();
+}
+
+void BitsetBuiltin::band(ListedBuiltin *, Context &context)
+{
+  combine(context, ArrayKernels::And);
+}
+
+void BitsetBuiltin::bor(ListedBuiltin *, Context &context)
+{
+  combine(context, ArrayKernels::Or);
+}
+
+void BitsetBuiltin::bxor(ListedBuiltin *, Context &context)
+{
+  combine(context, ArrayKernels::Xor);
+}
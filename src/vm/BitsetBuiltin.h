@@ -0,0 +1,41 @@
+#ifndef BITSETBUILTIN_H
+#define BITSETBUILTIN_H
+
+#include "Builtin.h"
+
+/**
+ * Bitsets, Bits arrays of ArrayStorage:
+ *   bitset N        N bits, all clear
+ *   bset [B, I]     bit I set
+ *   bclear [B, I]   bit I cleared
+ *   btest [B, I]    whether bit I is set
+ *   bcount B        number of bits set
+ *   bnext [B, I]    the first bit set from I on, 0 if none
+ *   band [A, B]     A set to A and B, bit by bit
+ *   bor [A, B]      A set to A or B
+ *   bxor [A, B]     A set to A xor B
+ *
+ * Bits are numbered from 1, and read as Bools by $B I as well. band,
+ * bor and bxor take bitsets of the same size. The work is done by
+ * ArrayKernels, a word at a time.
+ */
+class BitsetBuiltin: public ListedBuiltin
+{
+  public:
+    BitsetBuiltin(StringTable *strings);
+
+  private:
+    static void bitset(ListedBuiltin *self, Context &context);
+    static void bset(ListedBuiltin *self, Context &context);
+    static void bclear(ListedBuiltin *self, Context &context);
+    static void btest(ListedBuiltin *self, Context &context);
+    static void bcount(ListedBuiltin *self, Context &context);
+    static void bnext(ListedBuiltin *self, Context &context);
+    static void band(ListedBuiltin *self, Context &context);
+    static void bor(ListedBuiltin *self, Context &context);
+    static void bxor(ListedBuiltin *self, Context &context);
+
+    static const ListedBuiltin::Definition defs[];
+};
+
+#endif // BITSETBUILTIN_H
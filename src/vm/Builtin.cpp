@@ -27,3 +27,68 @@ bool ListedBuiltin::call(StringTable::Ref name, Context &context)
   return false;
 }
 
+
+CallArgs::CallArgs(Context &context, size_t count)
+  : m_context(context)
+{
+  const Stack<Value> &stack = context.stack;
+  size_t n = stack.size();
+  if (count == 1 && n >= 1 && !isBound(stack[n-1]))
+  {
+    m_first = n-1;
+    return;
+  }
+  if (count == 1 || n < count+2 || stack[n-1].type() != Value::TupClose
+      || stack[n-count-2].type() != Value::TupOpen)
+    throw Context::BadType();
+  m_first = n-count-1;
+  for (size_t i=m_first; i<n-1; i++)
+    if (isBound(stack[i]))
+      throw Context::BadType();
+}
+
+Value CallArgs::array(size_t i) const
+{
+  Value v = (*this)[i];
+  if (v.type() != Value::Array)
+    throw Context::BadType();
+  return v;
+}
+
+Value CallArgs::dict(size_t i) const
+{
+  Value v = (*this)[i];
+  if (v.type() != Value::Dict)
+    throw Context::BadType();
+  return v;
+}
+
+Value CallArgs::bitset(size_t i) const
+{
+  Value v = array(i);
+  if (m_context.arrays.kind(v) != ArrayStorage::Bits)
+    throw Context::BadType();
+  return v;
+}
+
+void CallArgs::ret()
+{
+  m_context.popdelete();
+  m_context.push(Value::TupOpen);
+  m_context.push(Value::TupClose);
+}
+
+void CallArgs::ret(const Value &v)
+{
+  m_context.popdelete();
+  m_context.push(v);
+}
+
+void CallArgs::ret(const Value &a, const Value &b)
+{
+  m_context.popdelete();
+  m_context.push(Value::TupOpen);
+  m_context.push(a);
+  m_context.push(b);
+  m_context.push(Value::TupClose);
+}
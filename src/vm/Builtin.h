@@ -44,4 +44,36 @@ class ListedBuiltin: public AbstractBuiltin
     size_t m_bindingCount;
 };
 
+/**
+ * The arguments of a builtin call: a tuple of count values, or a 
+ * single one. They stay on the stack, reachable by the collector, 
+ * until ret replaces them with the result.
+ */
+class CallArgs
+{
+  public:
+    // Whether the arguments are a tuple
+    static bool isTuple(Context &context)
+      { return !context.stack.empty() && context.stack.top().type() == Value::TupClose; }
+
+    CallArgs(Context &context, size_t count);
+
+    Value operator [](size_t i) const { return m_context.stack[m_first+i]; }
+    // Argument i, which must be an array, a dictionary, or a bitset
+    Value array(size_t i) const;
+    Value dict(size_t i) const;
+    Value bitset(size_t i) const;
+
+    void ret();
+    void ret(const Value &v);
+    void ret(const Value &a, const Value &b);
+
+  private:
+    static bool isBound(const Value &v)
+      { return v.type() == Value::TupOpen || v.type() == Value::TupClose; }
+
+    Context &m_context;
+    size_t m_first;
+};
+
 #endif // BUILTIN_H
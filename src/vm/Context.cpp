@@ -55,7 +55,11 @@ Value Context::getVar(unsigned int name)
 void Context::setVar(unsigned int name, const Value &val)
 {
   if (globals.isVar(name))
+  {
+    if (arrays.inRegion(val, 0))
+      throw ArrayStorage::RegionEscape();
     globals.setVar(name, val);
+  }
   else
     locals.top().setVar(name, val);
 }
@@ -63,10 +67,48 @@ void Context::setVar(unsigned int name, const Value &val)
 void Context::openScope()
 {
   locals.push(Scope());
+  locals.top().setRegionMark(arrays.regionMark());
 }
 
 void Context::closeScope()
 {
+  size_t mark = locals.top().regionMark();
+  if (arrays.regionMark() > mark)
+  {
+    // The return value is on top of the stack
+    int level = 0;
+    for (size_t i = stack.size(); i-- > 0; )
+    {
+      const Value &v = stack[i];
+      if (v.type() == Value::TupClose)
+        level++;
+      else if (v.type() == Value::TupOpen)
+        level--;
+      else if (arrays.inRegion(v, locals.size()))
+        throw ArrayStorage::RegionEscape();
+      if (level == 0)
+        break;
+    }
+    arrays.releaseRegion(mark);
+  }
+
+  const Vector<Value> &owned = locals.top().ownedArrays();
+  // The collector may have taken some already
+  for (size_t i=0; i<owned.size(); i++)
+    if (arrays.isLive(owned[i]))
+      arrays.free(owned[i]);
   locals.pop();
 }
 
+Value Context::allocRegionArray(int size)
+{
+  return arrays.allocRegion(size, locals.size());
+}
+
+Value Context::allocFrameArray(int size)
+{
+  Value ref = arrays.alloc(size);
+  locals.top().ownArray(ref);
+  return ref;
+}
+
@@ -33,6 +33,12 @@ struct Context
   void openScope();
   void closeScope();
 
+  // An array released on closeScope
+  Value allocFrameArray(int size);
+  // An array of the frame's region, released on closeScope. It may not
+  // be returned, nor stored to globals (see ArrayStorage for arrays).
+  Value allocRegionArray(int size);
+
   Stack<Value> stack;
   Scope globals;
   Stack<Scope> locals;
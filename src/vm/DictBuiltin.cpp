@@ -0,0 +1,58 @@
+#include "DictBuiltin.h"
+
+
+const ListedBuiltin::Definition DictBuiltin::defs[] =
+{
+  {"dict", DictBuiltin::dict},
+  {"get", DictBuiltin::get},
+  {"set", DictBuiltin::set},
+  {"has", DictBuiltin::has},
+  {"delete", DictBuiltin::remove},
+  {"keys", DictBuiltin::keys},
+};
+
+DictBuiltin::DictBuiltin(StringTable *strings)
+  : ListedBuiltin(strings, defs, sizeof(defs)/sizeof(ListedBuiltin::Definition))
+{
+}
+
+void DictBuiltin::dict(ListedBuiltin *, Context &context)
+{
+  CallArgs args(context, 0);
+  args.ret(context.arrays.allocDict());
+}
+
+void DictBuiltin::get(ListedBuiltin *, Context &context)
+{
+  CallArgs args(context, 2);
+  Value val;
+  if (!context.arrays.dictGet(args.dict(0), args[1], val))
+    throw MissingKey();
+  args.ret(val);
+}
+
+void DictBuiltin::set(ListedBuiltin *, Context &context)
+{
+  CallArgs args(context, 3);
+  context.arrays.dictSet(args.dict(0), args[1], args[2]);
+  args.ret();
+}
+
+void DictBuiltin::has(ListedBuiltin *, Context &context)
+{
+  CallArgs args(context, 2);
+  Value val;
+  args.ret(context.arrays.dictGet(args.dict(0), args[1], val));
+}
+
+void DictBuiltin::remove(ListedBuiltin *, Context &context)
+{
+  CallArgs args(context, 2);
+  args.ret(context.arrays.dictRemove(args.dict(0), args[1]));
+}
+
+void DictBuiltin::keys(ListedBuiltin *, Context &context)
+{
+  CallArgs args(context, 1);
+  args.ret(context.arrays.dictKeys(args.dict(0)));
+}
@@ -0,0 +1,36 @@
+#ifndef DICTBUILTIN_H
+#define DICTBUILTIN_H
+
+#include "Builtin.h"
+
+/**
+ * Dictionaries, kept by ArrayStorage:
+ *   dict []            a new empty dictionary
+ *   get [D, K]         the value of key K, MissingKey if not set
+ *   set [D, K, V]      key K set to V
+ *   has [D, K]         whether key K is set
+ *   delete [D, K]      key K unset, returns whether it was set
+ *   keys D             array of the keys, in no particular order
+ *
+ * Keys are Ints, Strings or Bools. size D is the number of keys.
+ */
+class DictBuiltin: public ListedBuiltin
+{
+  public:
+    // Exceptions
+    class MissingKey {};
+
+    DictBuiltin(StringTable *strings);
+
+  private:
+    static void dict(ListedBuiltin *self, Context &context);
+    static void get(ListedBuiltin *self, Context &context);
+    static void set(ListedBuiltin *self, Context &context);
+    static void has(ListedBuiltin *self, Context &context);
+    static void remove(ListedBuiltin *self, Context &context);
+    static void keys(ListedBuiltin *self, Context &context);
+
+    static const ListedBuiltin::Definition defs[];
+};
+
+#endif // DICTBUILTIN_H
@@ -1,10 +1,14 @@
 #include <cstddef>
 #include "Executor.h"
 #include "Builtin.h"
+#include "ArrayKernels.h"
+#include "NumericBuiltin.h"
+#include "DictBuiltin.h"
 #include "File.h"
 
 Executor::Executor(Program &program, StringTable *strings)
-  : m_prog(program), m_pc(0), m_stopped(true) 
+  : m_prog(program), m_pc(0), m_stopped(true), m_gc(m_context), m_profile(NULL),
+    m_allChecked(false)
 {
   m_context.strings = strings;
   for (size_t i=0; i<program.globalsCount(); i++)
@@ -14,25 +18,71 @@ Executor::Executor(Program &program, StringTable *strings)
 void Executor::exec(const Instruction &instr)
 {
   if (instr.isPush())
-    m_context.push(execPush(instr));
+  {
+    Value v = execPush(instr);
+    if (m_profile != NULL)
+      m_profile->recordType(m_pc, v.type());
+    m_context.push(v);
+  }
   else if (instr.isBinOp())
   {
     Value right = m_context.popValue();
     Value left = m_context.popValue();
+    if (m_profile != NULL)
+    {
+      m_profile->recordType(m_pc, left.type());
+      m_profile->recordType(m_pc, right.type());
+    }
     m_context.push(execBinOp(instr, left, right));
   }
+  else if (instr.isIntOp())
+  {
+    Value right = m_context.popValue();
+    Value left = m_context.popValue();
+    if (m_profile != NULL)
+    {
+      m_profile->recordType(m_pc, left.type());
+      m_profile->recordType(m_pc, right.type());
+    }
+    if (left.type() == Value::Int && right.type() == Value::Int)
+      m_context.push(execIntOp(instr, left.asInt(), right.asInt()));
+    else
+    {
+      // Guard failed: despecialize the site for good
+      Instruction &site = m_prog[m_pc];
+      site.opcode = Instruction::genericVariant(site.opcode);
+      m_context.push(execBinOp(site, left, right));
+    }
+  }
   else switch (instr.opcode)
   {
       // Pop from stack
     case Instruction::PopVar:
-      m_context.setVar(instr.arg.atom, m_context.popValue());
-      break;
+    {
+      Value val = m_context.popValue();
+      if (m_profile != NULL)
+        m_profile->recordType(m_pc, val.type());
+      m_context.setVar(instr.arg.atom, val);
+    } break;
     case Instruction::PopArrayItem:
     {
       Value index = m_context.pop(Value::Int);
       Value val = m_context.popValue();
       m_context.arrays.set(m_context.getVar(instr.arg.atom), index, val);
     } break;
+    case Instruction::PopArrayItemUnchecked:
+    {
+      Value index = m_context.pop(Value::Int);
+      Value val = m_context.popValue();
+      m_context.arrays.setUnchecked(m_context.getVar(instr.arg.atom), index.asInt(), val);
+    } break;
+    case Instruction::PopArrayCell:
+    {
+      Value ref = m_context.getVar(instr.arg.atom);
+      int index = popCell(ref, instr.arg.cell.rank);
+      Value val = m_context.popValue();
+      m_context.arrays.setUnchecked(ref, index, val);
+    } break;
     case Instruction::PopDelete:
       m_context.popdelete();
       break;
@@ -60,6 +110,26 @@ void Executor::exec(const Instruction &instr)
       ret();
       break;
 
+    case Instruction::AllocFrameArray:
+      m_context.push(m_context.allocFrameArray(m_context.pop(Value::Int).asInt()));
+      break;
+
+      // Array range guard
+    case Instruction::GuardArrayRange:
+    {
+      // Indices [first+firstOffset, last+lastOffset] of ref
+      Value lastOffset = m_context.popValue();
+      Value last = m_context.popValue();
+      Value firstOffset = m_context.popValue();
+      Value first = m_context.popValue();
+      Value ref = m_context.popValue();
+      if (first.type() != Value::Int || last.type() != Value::Int
+          || !m_context.arrays.inRange(ref, 
+            static_cast<long>(first.asInt()) + firstOffset.asInt(), 
+            static_cast<long>(last.asInt()) + lastOffset.asInt()))
+        uncheckArrays(m_pc+1, instr.arg.addr);
+    } break;
+
       // Special
     case Instruction::Trace:
       break;
@@ -83,6 +153,15 @@ Value Executor::execPush(const Instruction &instr)
                                      return m_context.arrays.get(
                                          m_context.getVar(instr.arg.atom), 
                                          m_context.pop(Value::Int));
+    case Instruction::PushArrayItemUnchecked:
+                                     return m_context.arrays.getUnchecked(
+                                         m_context.getVar(instr.arg.atom), 
+                                         m_context.pop(Value::Int).asInt());
+    case Instruction::PushArrayCell:
+    {
+      Value ref = m_context.getVar(instr.arg.atom);
+      return m_context.arrays.getUnchecked(ref, popCell(ref, instr.arg.cell.rank));
+    }
     case Instruction::Dup:           return m_context.stack.top();
     case Instruction::TupOpen:       return Value::TupOpen;
     case Instruction::TupClose:      return Value::TupClose;
@@ -93,6 +172,10 @@ Value Executor::execPush(const Instruction &instr)
 Value Executor::execBinOp(const Instruction &instr, 
     const Value &left, const Value &right)
 {
+  // Arithmetic goes elementwise over arrays
+  if ((left.type() == Value::Array || right.type() == Value::Array)
+      && instr.opcode >= Instruction::Add && instr.opcode <= Instruction::Div)
+    return execArrayOp(instr, left, right);
   switch (instr.opcode)
   {
     case Instruction::Add:              return left + right;
@@ -102,6 +185,8 @@ Value Executor::execBinOp(const Instruction &instr,
     case Instruction::Mod:              return left % right;
     case Instruction::And:              return left && right;
     case Instruction::Or:               return left || right;
+    case Instruction::ShiftRight:       return left >> right;
+    case Instruction::BitAnd:           return left & right;
     case Instruction::TestLess:         return left < right;
     case Instruction::TestGreater:      return left > right;
     case Instruction::TestEqual:        return left == right;
@@ -111,6 +196,148 @@ Value Executor::execBinOp(const Instruction &instr,
   }
 }
 
+// Pops rank indices, giving the item of ref they address
+int Executor::popCell(const Value &ref, size_t rank)
+{
+  if (rank > ArrayStorage::MaxRank)
+    throw ArrayStorage::BadIndex();
+  int index[ArrayStorage::MaxRank];
+  for (size_t i = rank; i-- > 0; )
+    index[i] = m_context.pop(Value::Int).asInt();
+  return m_context.arrays.cell(ref, index, rank);
+}
+
+// A new array of left op right, item by item, of the shape of both
+// arrays; a number operand applies to every item. Boxed items go through execBinOp, so nested 
+// arrays are handled too. Packed operands give a packed array, of 
+// reals when either side holds reals.
+Value Executor::execArrayOp(const Instruction &instr, 
+    const Value &left, const Value &right)
+{
+  ArrayStorage &arrays = m_context.arrays;
+  bool leftArray = left.type() == Value::Array;
+  bool rightArray = right.type() == Value::Array;
+  const Value &a = leftArray? left : right;  // An array operand
+  const Value &x = leftArray? right : left;  // The other one
+  size_t n = arrays.size(a);
+  if (leftArray && rightArray && !arrays.sameShape(left, right))
+    throw ArrayStorage::SizeMismatch();
+  if (!(leftArray && rightArray) && x.type() != Value::Int && x.type() != Value::Real)
+    throw Value::TypeMismatch();
+
+  ArrayStorage::Kind kinds[2];
+  for (int i=0; i<2; i++)
+  {
+    const Value &v = i == 0? left : right;
+    // Bools of Bits arrays go through execBinOp as boxed items do
+    if (v.type() == Value::Array && arrays.kind(v) != ArrayStorage::Bits)
+      kinds[i] = arrays.kind(v);
+    else if (v.type() == Value::Int)
+      kinds[i] = ArrayStorage::Ints;
+    else if (v.type() == Value::Real)
+      kinds[i] = ArrayStorage::Reals;
+    else
+      kinds[i] = ArrayStorage::Boxed;
+  }
+  ArrayStorage::Kind kind = (kinds[0] == ArrayStorage::Boxed || kinds[1] == ArrayStorage::Boxed)? 
+    ArrayStorage::Boxed : (kinds[0] == ArrayStorage::Reals || kinds[1] == ArrayStorage::Reals)? 
+    ArrayStorage::Reals : ArrayStorage::Ints;
+
+  // The operands are popped already: keep them and the result on the 
+  // stack while allocating
+  m_context.push(left);
+  m_context.push(right);
+  Value result = arrays.alloc(n, kind);
+  m_context.push(result);
+  arrays.reshapeLike(result, a);
+
+  ArrayKernels::Op op = ArrayKernels::Add;
+  switch (instr.opcode)
+  {
+    case Instruction::Sub: op = ArrayKernels::Sub; break;
+    case Instruction::Mul: op = ArrayKernels::Mul; break;
+    case Instruction::Div: op = ArrayKernels::Div; break;
+    default: break;
+  }
+  if (kind == ArrayStorage::Boxed)
+  {
+    for (size_t i=1; i<=n; i++)
+    {
+      Value l = leftArray? arrays.getUnchecked(left, i) : left;
+      Value r = rightArray? arrays.getUnchecked(right, i) : right;
+      arrays.setUnchecked(result, i, execBinOp(instr, l, r));
+    }
+  }
+  else if (kind == ArrayStorage::Ints)
+  {
+    int *out = arrays.writableInts(result);
+    if (leftArray && rightArray)
+      ArrayKernels::map(op, arrays.ints(left), arrays.ints(right), out, n);
+    else
+      ArrayKernels::map(op, arrays.ints(a), x.asInt(), !leftArray, out, n);
+  }
+  else
+  {
+    // Int items are widened into the result first
+    double *out = arrays.writableReals(result);
+    const double *items[2];
+    for (int i=0; i<2; i++)
+    {
+      const Value &v = i == 0? left : right;
+      if (v.type() != Value::Array)
+        continue;
+      if (kinds[i] == ArrayStorage::Reals)
+        items[i] = arrays.reals(v);
+      else
+      {
+        ArrayKernels::widen(arrays.ints(v), out, n);
+        items[i] = out;
+      }
+    }
+    if (leftArray && rightArray)
+      ArrayKernels::map(op, items[0], items[1], out, n);
+    else
+      ArrayKernels::map(op, items[leftArray? 0 : 1], x.toReal(), !leftArray, out, n);
+  }
+
+  m_context.stack.pop();
+  m_context.stack.pop();
+  m_context.stack.pop();
+  return result;
+}
+
+Value Executor::execIntOp(const Instruction &instr, int left, int right)
+{
+  switch (instr.opcode)
+  {
+    case Instruction::AddInt:              return left + right;
+    case Instruction::SubInt:              return left - right;
+    case Instruction::MulInt:              return left * right;
+    case Instruction::DivInt:              return left / right;
+    case Instruction::ModInt:              return left % right;
+    case Instruction::TestLessInt:         return left < right;
+    case Instruction::TestGreaterInt:      return left > right;
+    case Instruction::TestEqualInt:        return left == right;
+    case Instruction::TestLessEqualInt:    return left <= right;
+    case Instruction::TestGreaterEqualInt: return left >= right;
+    default:                               trap(); return 0;
+  }
+}
+
+// Guard failed: the unchecked accesses in [begin, end) go back 
+// to checked ones for good
+void Executor::uncheckArrays(size_t begin, size_t end)
+{
+  for (size_t addr = begin; addr < end; addr++)
+  {
+    Instruction &instr = m_prog[addr];
+    if (instr.opcode == Instruction::PushArrayItemUnchecked)
+      instr.opcode = Instruction::PushArrayItem;
+    else if (instr.opcode == Instruction::PopArrayItemUnchecked)
+      instr.opcode = Instruction::PopArrayItem;
+  }
+}
+
 // ========================================
 
 void Executor::trap()
@@ -126,12 +353,7 @@ void Executor::jump(size_t addr)
 
 void Executor::call(StringTable::Ref name, bool saveRet)
 {
-  // Builtin
-  for (size_t i=0; i<m_builtins.size(); i++)
-    if (m_builtins[i]->call(name, m_context))
-      return;
-
-  // Declared
+  // Declared first, so that a script may define a builtin's name itself
   for (size_t i=0; i<m_prog.entryCount(); i++)
     if (m_prog.entry(i).name.id() == name)
     {
@@ -142,6 +364,19 @@ void Executor::call(StringTable::Ref name, bool saveRet)
       jump(m_prog.entry(i).addr);
       return;
     }
+
+  // Builtin
+  for (size_t i=0; i<m_builtins.size(); i++)
+    if (m_builtins[i]->call(name, m_context))
+    {
+      // Bounds checks were eliminated for sizes that never shrink
+      if (m_context.arrays.shrunk() && !m_allChecked)
+      {
+        uncheckArrays(0, m_prog.size());
+        m_allChecked = true;
+      }
+      return;
+    }
   throw Undefined(Undefined::Function, Atom(name, m_context.strings), m_pc);
 }
 
@@ -191,10 +426,46 @@ void Executor::run(StringTable::Ref entryFun)
   {
     throw Undefined(Undefined::Variable, Atom("<unk>", m_context.strings), m_pc);
   }
+  catch (ArrayStorage::HeapLimit)
+  {
+    throw Exception("Heap limit exceeded", m_pc);
+  }
+  catch (ArrayStorage::BadIndex)
+  {
+    throw Exception("Array index out of range", m_pc);
+  }
+  catch (ArrayStorage::SizeMismatch)
+  {
+    throw Exception("Array sizes differ", m_pc);
+  }
+  catch (ArrayStorage::BadSize)
+  {
+    throw Exception("Bad array size", m_pc);
+  }
+  catch (ArrayStorage::BadItem &e)
+  {
+    throw BadType(e.expected(), e.found(), m_pc);
+  }
+  catch (ArrayStorage::RegionEscape)
+  {
+    throw Exception("Local array escapes", m_pc);
+  }
+  catch (NumericBuiltin::Singular)
+  {
+    throw Exception("Singular matrix", m_pc);
+  }
+  catch (DictBuiltin::MissingKey)
+  {
+    throw Exception("Dictionary key not found", m_pc);
+  }
 }
 
 void Executor::step()
 {
+  if (m_gc.isDue())
+    m_gc.collect();
+  if (m_profile != NULL)
+    m_profile->hit(m_pc);
   exec(m_prog[m_pc]);
   m_pc++;
 }
@@ -8,6 +8,8 @@
 #include "Value.h"
 #include "Context.h"
 #include "Builtin.h"
+#include "Profile.h"
+#include "GarbageCollector.h"
 
 /**
  * A linear code executor.
@@ -60,6 +62,14 @@ class Executor
     Executor(Program &program, StringTable *strings);
 
     void addBuiltin(AbstractBuiltin *b);
+    // Record hit counts and type feedback while running
+    void setProfile(Profile *profile) { m_profile = profile; }
+    const ArrayStorage &arrays() const { return m_context.arrays; }
+    // Past limit bytes of arrays, running fails with an Exception;
+    // 0 for no limit
+    void setHeapLimit(size_t bytes) { m_context.arrays.setLimit(bytes); }
+    GarbageCollector &gc() { return m_gc; }
+    const GarbageCollector &gc() const { return m_gc; }
     void run(StringTable::Ref entryFun);
     void run(const char *entryName);
 
@@ -78,6 +88,11 @@ class Executor
     Value execPush(const Instruction &instr);
     Value execBinOp(const Instruction &instr, 
         const Value &left, const Value &right);
+    Value execIntOp(const Instruction &instr, int left, int right);
+    int popCell(const Value &ref, size_t rank);
+    Value execArrayOp(const Instruction &instr, 
+        const Value &left, const Value &right);
+    void uncheckArrays(size_t begin, size_t end);
     void step();
 
     // Data
@@ -87,6 +102,9 @@ class Executor
     Stack<size_t> m_callStack;
     Vector<AbstractBuiltin *> m_builtins;
     Context m_context;
+    GarbageCollector m_gc;
+    Profile *m_profile;
+    bool m_allChecked;  // Unchecked accesses undone, an array having shrunk
 };
 
 #endif // EXECUTOR_H
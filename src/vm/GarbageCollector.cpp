@@ -0,0 +1,166 @@
+#include <cstdlib>
+#include <cstring>
+#include "GarbageCollector.h"
+#include "Clock.h"
+
+// Units of work between looks at the clock
+static const size_t ChunkWork = 256;
+static const size_t StressChunkWork = 16;
+
+GarbageCollector::Stats::Stats()
+  : minorCollections(0), collections(0), forcedCollections(0), slices(0), totalPause(0), maxPause(0), 
+    arraysReclaimed(0), bytesReclaimed(0)
+{
+  for (size_t i=0; i<PauseBuckets; i++)
+    pauses[i] = 0;
+}
+
+GarbageCollector::GarbageCollector(Context &context)
+  : m_context(context), m_pauseLimit(DefaultPauseLimit), m_stress(false),
+    m_threshold(InitialThreshold), m_due(InitialThreshold), m_lastSlice(0),
+    m_cycleStart(0), m_arrays(0), m_bytes(0)
+{
+  const char *stress = getenv("MSL_GC_STRESS");
+  m_stress = stress != NULL && *stress != '\0' && 0 != strcmp(stress, "0");
+  if (m_stress)
+    m_due = 1;
+  m_context.arrays.setReclaimer(this);
+}
+
+void GarbageCollector::collect()
+{
+  ArrayStorage &arrays = m_context.arrays;
+  if (arrays.nurseryFull() || (m_stress && arrays.nurseryUsed() > 0))
+    collectNursery();
+  // Promotions count as allocations
+  if (arrays.bytesAllocated() - m_lastSlice >= m_due)
+    slice();
+}
+
+void GarbageCollector::collectNursery(const Value &keep)
+{
+  unsigned long start = Clock::micros();
+  ArrayStorage &arrays = m_context.arrays;
+  arrays.promote(keep);
+  for (size_t i=0; i<m_context.stack.size(); i++)
+    arrays.promote(m_context.stack[i]);
+  promoteScope(m_context.globals);
+  for (size_t i=0; i<m_context.locals.size(); i++)
+    promoteScope(m_context.locals[i]);
+  arrays.finishMinor();
+
+  m_stats.minorCollections++;
+  recordPause(Clock::micros() - start);
+}
+
+void GarbageCollector::slice()
+{
+  unsigned long start = Clock::micros();
+  ArrayStorage &arrays = m_context.arrays;
+  if (arrays.phase() == ArrayStorage::Idle)
+    startCycle();
+
+  // Outrun by the program: finish now rather than let the heap grow
+  bool finish = m_pauseLimit == 0 
+    || arrays.bytesAllocated() - m_cycleStart >= m_threshold;
+  size_t chunk = m_stress? StressChunkWork : ChunkWork;
+  unsigned long now = start, last;
+  do
+  {
+    last = now;
+    advance(chunk);
+    now = Clock::micros();
+  }
+  // Stop short of the limit if another chunk like the last would pass it
+  while (arrays.phase() != ArrayStorage::Idle 
+      && (finish || (!m_stress && now - start + (now - last) <= m_pauseLimit)));
+
+  m_lastSlice = arrays.bytesAllocated();
+  m_stats.slices++;
+  recordPause(now - start);
+}
+
+void GarbageCollector::reclaim(const Value &keep)
+{
+  collectNursery(keep);
+
+  unsigned long start = Clock::micros();
+  ArrayStorage &arrays = m_context.arrays;
+  // Garbage made since the cycle under way started outlives it
+  while (!advance(ChunkWork))
+    ;
+  startCycle();
+  arrays.shade(keep);
+  while (!advance(ChunkWork))
+    ;
+
+  m_lastSlice = arrays.bytesAllocated();
+  m_stats.forcedCollections++;
+  recordPause(Clock::micros() - start);
+}
+
+// Does a chunk of work of the cycle, returns whether none is under way
+bool GarbageCollector::advance(size_t chunk)
+{
+  ArrayStorage &arrays = m_context.arrays;
+  if (arrays.phase() == ArrayStorage::Marking)
+  {
+    if (arrays.trace(chunk))
+      arrays.startSweeping();
+  }
+  else if (arrays.phase() == ArrayStorage::Sweeping 
+      && arrays.sweep(chunk, m_arrays, m_bytes))
+    finishCycle();
+  return arrays.phase() == ArrayStorage::Idle;
+}
+
+void GarbageCollector::startCycle()
+{
+  m_context.arrays.startMarking();
+  for (size_t i=0; i<m_context.stack.size(); i++)
+    m_context.arrays.shade(m_context.stack[i]);
+  shadeScope(m_context.globals);
+  for (size_t i=0; i<m_context.locals.size(); i++)
+    shadeScope(m_context.locals[i]);
+
+  m_cycleStart = m_context.arrays.bytesAllocated();
+  m_arrays = m_bytes = 0;
+  m_due = m_stress? 1 : SliceBytes;
+}
+
+void GarbageCollector::finishCycle()
+{
+  m_stats.collections++;
+  m_stats.arraysReclaimed += m_arrays;
+  m_stats.bytesReclaimed += m_bytes;
+
+  // The heap may grow as much as it holds now before the next cycle
+  m_threshold = m_context.arrays.bytesInUse();
+  if (m_threshold < InitialThreshold)
+    m_threshold = InitialThreshold;
+  m_due = m_stress? 1 : m_threshold;
+}
+
+void GarbageCollector::shadeScope(const Scope &scope)
+{
+  for (size_t i=0; i<scope.varCount(); i++)
+    m_context.arrays.shade(scope.varAt(i));
+}
+
+void GarbageCollector::promoteScope(const Scope &scope)
+{
+  for (size_t i=0; i<scope.varCount(); i++)
+    m_context.arrays.promote(scope.varAt(i));
+}
+
+void GarbageCollector::recordPause(unsigned long micros)
+{
+  m_stats.totalPause += micros;
+  if (micros > m_stats.maxPause)
+    m_stats.maxPause = micros;
+
+  size_t bucket = 0;
+  for (unsigned long m = micros; m != 0 && bucket < PauseBuckets-1; m >>= 1)
+    bucket++;
+  m_stats.pauses[bucket]++;
+}
@@ -0,0 +1,104 @@
+#ifndef GARBAGE_COLLECTOR_H
+#define GARBAGE_COLLECTOR_H
+
+#include "Value.h"
+#include "Context.h"
+
+/**
+ * A generational collector of the arrays of a Context.
+ *
+ * Roots are the value stack, the globals and every frame of locals;
+ * arrays stored in arrays are traced. A minor collection empties the
+ * nursery of ArrayStorage once it is full, promoting the survivors.
+ *
+ * Major collections are incremental mark-sweep cycles. A cycle starts 
+ * once the bytes allocated to the old space since the last one reach
+ * a threshold, which grows along with the live heap. 
+ *
+ * A cycle is split into slices, interleaved with the program: one 
+ * slice is due per SliceBytes allocated, and runs for at most the 
+ * pause limit. Slices only run at safepoints, between instructions 
+ * (see Executor::step). The roots are shaded all at once when a cycle
+ * starts; from then on, the write barrier of ArrayStorage keeps what
+ * they reached alive. Should the program allocate as much as the 
+ * threshold during one cycle, the cycle is finished at once.
+ *
+ * An allocation over the heap limit of ArrayStorage collects at once:
+ * a minor collection, then the cycle under way and a whole new one,
+ * so that all garbage is freed. This only happens within builtins and
+ * array stores, whose operands are still held.
+ *
+ * With MSL_GC_STRESS set in the environment, a minor collection and
+ * a major slice are due after every allocation, and the slice does
+ * little work.
+ */
+class GarbageCollector: public ArrayStorage::Reclaimer
+{
+  public:
+    // Pauses taking under 2^i microseconds count in pauses[i]
+    static const size_t PauseBuckets = 16;
+
+    struct Stats
+    {
+      Stats();
+      size_t minorCollections;
+      size_t collections;
+      size_t forcedCollections; // By the heap limit
+      size_t slices;            // Of major collections
+      unsigned long totalPause; // Microseconds
+      unsigned long maxPause;
+      size_t arraysReclaimed;
+      size_t bytesReclaimed;
+      size_t pauses[PauseBuckets];
+    };
+
+    // Bytes allocated before the first cycle
+    static const size_t InitialThreshold = 1 << 20;
+    // Bytes allocated between slices
+    static const size_t SliceBytes = 64 << 10;
+    // Default slice length, microseconds
+    static const unsigned long DefaultPauseLimit = 1000;
+
+    GarbageCollector(Context &context);
+
+    // A limit of 0 makes every cycle a single slice
+    void setPauseLimit(unsigned long micros) { m_pauseLimit = micros; }
+    unsigned long pauseLimit() const { return m_pauseLimit; }
+
+    bool isDue() const
+    {
+      const ArrayStorage &arrays = m_context.arrays;
+      return arrays.nurseryFull() || arrays.bytesAllocated() - m_lastSlice >= m_due
+        || (m_stress && arrays.nurseryUsed() > 0);
+    }
+    // Run a minor collection or a major slice, as due
+    void collect();
+    // Reimplemented from ArrayStorage::Reclaimer
+    virtual void reclaim(const Value &keep);
+
+    bool stress() const { return m_stress; }
+    const Stats &stats() const { return m_stats; }
+
+  private:
+    void collectNursery(const Value &keep = Value());
+    void slice();
+    bool advance(size_t chunk);
+    void startCycle();
+    void finishCycle();
+    void shadeScope(const Scope &scope);
+    void promoteScope(const Scope &scope);
+    void recordPause(unsigned long micros);
+
+    Context &m_context;
+    unsigned long m_pauseLimit;
+    bool m_stress;
+    size_t m_threshold;
+    size_t m_due;        // Bytes to allocate before the next slice
+    size_t m_lastSlice;  // bytesAllocated after the last slice
+    size_t m_cycleStart; // bytesAllocated when the cycle started
+    size_t m_arrays;     // Reclaimed by the current cycle
+    size_t m_bytes;
+    Stats m_stats;
+};
+
+#endif // GARBAGE_COLLECTOR_H
@@ -14,17 +14,26 @@ struct Instruction
   enum Opcode
   {
     // Push to stack
-    PushVar, PushInt, PushReal, PushBool, PushString, PushArrayItem, Dup,
+    PushVar, PushInt, PushReal, PushBool, PushString, 
+    PushArrayItem, PushArrayItemUnchecked, PushArrayCell, Dup,
     // Tuple boundaries
     TupOpen, TupClose, TupUnOpen, TupUnClose,
     // Pop from stack
-    PopVar, PopArrayItem, PopDelete,
+    PopVar, PopArrayItem, PopArrayItemUnchecked, PopArrayCell, PopDelete,
     // Operations
-    Add, Sub, Mul, Div, Mod, And, Or,
+    Add, Sub, Mul, Div, Mod, And, Or, ShiftRight, BitAnd,
     // Tests
     TestLess, TestGreater, TestEqual, TestLessEqual, TestGreaterEqual,
+    // Int-specialized operations and tests (see Profile::specialize)
+    AddInt, SubInt, MulInt, DivInt, ModInt,
+    TestLessInt, TestGreaterInt, TestEqualInt, 
+    TestLessEqualInt, TestGreaterEqualInt,
     // Jumps
     Jump, JumpIfNot, Call, Return,
+    // Array range guard (see BoundsCheckEliminator)
+    GuardArrayRange,
+    // Array owned by the function's frame (see EscapeOptimizer)
+    AllocFrameArray,
     // Special (debug)
     Trap, Trace
   };
@@ -36,6 +45,12 @@ struct Instruction
     size_t addr;
     StringTable::Ref atom;
     AST::Base *trace;
+    // Array cells: the array, and how many indices precede
+    struct
+    {
+      StringTable::Ref atom;
+      unsigned int rank;
+    } cell;
   };
 
   Instruction(Opcode op=Trap, int intval=0)
@@ -50,9 +65,60 @@ struct Instruction
    : opcode(op) { arg.atom = atom.id(); } 
   Instruction(Opcode op, AST::Base *trace)
    : opcode(op) { arg.trace = trace; } 
+  Instruction(Opcode op, const Atom &atom, unsigned int rank)
+   : opcode(op) { arg.cell.atom = atom.id(); arg.cell.rank = rank; } 
 
   bool isPush() const { return opcode >= PushVar && opcode <= TupClose; }
   bool isBinOp() const { return opcode >= Add && opcode <= TestGreaterEqual; }
+  bool isIntOp() const { return opcode >= AddInt && opcode <= TestGreaterEqualInt; }
+  // Cells take one index per dimension, items a single one
+  bool isArrayCell() const { return opcode == PushArrayCell || opcode == PopArrayCell; }
+  bool isArrayRead() const 
+    { return opcode == PushArrayItem || opcode == PushArrayItemUnchecked
+        || opcode == PushArrayCell; }
+  bool isArrayWrite() const 
+    { return opcode == PopArrayItem || opcode == PopArrayItemUnchecked
+        || opcode == PopArrayCell; }
+  // The argument is a code address
+  bool hasAddress() const 
+    { return opcode == Jump || opcode == JumpIfNot || opcode == GuardArrayRange; }
+
+  // Map between generic and Int-specialized opcodes.
+  // Opcodes without a counterpart are returned unchanged.
+  static Opcode intVariant(Opcode op)
+  {
+    switch (op)
+    {
+      case Add:              return AddInt;
+      case Sub:              return SubInt;
+      case Mul:              return MulInt;
+      case Div:              return DivInt;
+      case Mod:              return ModInt;
+      case TestLess:         return TestLessInt;
+      case TestGreater:      return TestGreaterInt;
+      case TestEqual:        return TestEqualInt;
+      case TestLessEqual:    return TestLessEqualInt;
+      case TestGreaterEqual: return TestGreaterEqualInt;
+      default:               return op;
+    }
+  }
+  static Opcode genericVariant(Opcode op)
+  {
+    switch (op)
+    {
+      case AddInt:              return Add;
+      case SubInt:              return Sub;
+      case MulInt:              return Mul;
+      case DivInt:              return Div;
+      case ModInt:              return Mod;
+      case TestLessInt:         return TestLess;
+      case TestGreaterInt:      return TestGreater;
+      case TestEqualInt:        return TestEqual;
+      case TestLessEqualInt:    return TestLessEqual;
+      case TestGreaterEqualInt: return TestGreaterEqual;
+      default:                  return op;
+    }
+  }
 
   Opcode opcode;
   Arg arg;
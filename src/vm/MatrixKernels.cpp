@@ -0,0 +1,377 @@
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <pthread.h>
+#include "MatrixKernels.h"
+#include "ArrayKernels.h"
+#include "Util.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define X86_KERNELS
+#include <immintrin.h>
+#define AVX2_CODE __attribute__((target("avx2")))
+#endif
+
+// Thread count limit
+static const size_t MaxThreads = 64;
+// Multiply-adds a thread is worth starting for
+static const double ThreadWork = 1 << 20;
+
+static size_t detectThreads()
+{
+  const char *count = getenv("MSL_THREADS");
+  long n = count == NULL? 1 : atol(count);
+  if (n < 1)
+    return 1;
+  return static_cast<size_t>(n) > MaxThreads? MaxThreads : n;
+}
+
+size_t MatrixKernels::threads()
+{
+  static size_t threads = detectThreads();
+  return threads;
+}
+
+static inline size_t min(size_t a, size_t b) { return a < b? a : b; }
+
+
+// ========= Real products
+
+// C (n x p) += A (n x m) * B (m x p), or -= when subtract, each with
+// its own row stride
+struct Product
+{
+  const double *a;
+  size_t lda;
+  const double *b;
+  size_t ldb;
+  double *c;
+  size_t ldc;
+  size_t n, m, p;
+  bool subtract;
+};
+
+// Rows [i0, i1) of C, over columns [j0, j1) and products [k0, k1).
+// Every item of C adds its products in k order: the vector kernel
+// must keep to it for the same results.
+static void blockScalar(const Product &prod, size_t i0, size_t i1,
+    size_t k0, size_t k1, size_t j0, size_t j1)
+{
+  for (size_t i = i0; i < i1; i++)
+  {
+    double *row = prod.c + i*prod.ldc;
+    for (size_t k = k0; k < k1; k++)
+    {
+      double x = prod.a[i*prod.lda + k];
+      if (prod.subtract)
+        x = -x;
+      const double *brow = prod.b + k*prod.ldb;
+      for (size_t j = j0; j < j1; j++)
+        row[j] += x * brow[j];
+    }
+  }
+}
+
+#ifdef X86_KERNELS
+
+// 4 rows by 8 columns of C held in registers over [k0, k1)
+AVX2_CODE static void kernelAvx2(const Product &prod, size_t i, size_t j,
+    size_t k0, size_t k1)
+{
+  double *c = prod.c + i*prod.ldc + j;
+  size_t ldc = prod.ldc;
+  __m256d c00 = _mm256_loadu_pd(c),         c01 = _mm256_loadu_pd(c + 4);
+  __m256d c10 = _mm256_loadu_pd(c + ldc),   c11 = _mm256_loadu_pd(c + ldc + 4);
+  __m256d c20 = _mm256_loadu_pd(c + 2*ldc), c21 = _mm256_loadu_pd(c + 2*ldc + 4);
+  __m256d c30 = _mm256_loadu_pd(c + 3*ldc), c31 = _mm256_loadu_pd(c + 3*ldc + 4);
+  const double *a = prod.a + i*prod.lda;
+  size_t lda = prod.lda;
+  double sign = prod.subtract? -1.0 : 1.0;
+  for (size_t k = k0; k < k1; k++)
+  {
+    const double *b = prod.b + k*prod.ldb + j;
+    __m256d b0 = _mm256_loadu_pd(b);
+    __m256d b1 = _mm256_loadu_pd(b + 4);
+    __m256d x = _mm256_set1_pd(sign * a[k]);
+    c00 = _mm256_add_pd(c00, _mm256_mul_pd(x, b0));
+    c01 = _mm256_add_pd(c01, _mm256_mul_pd(x, b1));
+    x = _mm256_set1_pd(sign * a[lda + k]);
+    c10 = _mm256_add_pd(c10, _mm256_mul_pd(x, b0));
+    c11 = _mm256_add_pd(c11, _mm256_mul_pd(x, b1));
+    x = _mm256_set1_pd(sign * a[2*lda + k]);
+    c20 = _mm256_add_pd(c20, _mm256_mul_pd(x, b0));
+    c21 = _mm256_add_pd(c21, _mm256_mul_pd(x, b1));
+    x = _mm256_set1_pd(sign * a[3*lda + k]);
+    c30 = _mm256_add_pd(c30, _mm256_mul_pd(x, b0));
+    c31 = _mm256_add_pd(c31, _mm256_mul_pd(x, b1));
+  }
+  _mm256_storeu_pd(c, c00);           _mm256_storeu_pd(c + 4, c01);
+  _mm256_storeu_pd(c + ldc, c10);     _mm256_storeu_pd(c + ldc + 4, c11);
+  _mm256_storeu_pd(c + 2*ldc, c20);   _mm256_storeu_pd(c + 2*ldc + 4, c21);
+  _mm256_storeu_pd(c + 3*ldc, c30);   _mm256_storeu_pd(c + 3*ldc + 4, c31);
+}
+
+// Kernel tiles, with the edges left to scalar code
+static void blockAvx2(const Product &prod, size_t i0, size_t i1,
+    size_t k0, size_t k1, size_t j0, size_t j1)
+{
+  size_t i = i0;
+  for (; i + 4 <= i1; i += 4)
+  {
+    size_t j = j0;
+    for (; j + 8 <= j1; j += 8)
+      kernelAvx2(prod, i, j, k0, k1);
+    blockScalar(prod, i, i + 4, k0, k1, j, j1);
+  }
+  blockScalar(prod, i, i1, k0, k1, j0, j1);
+}
+
+#endif // X86_KERNELS
+
+static void productRows(const Product &prod, size_t first, size_t last)
+{
+  const size_t Block = MatrixKernels::Block;
+#ifdef X86_KERNELS
+  bool avx2 = ArrayKernels::level() == ArrayKernels::AVX2;
+#endif
+  for (size_t i0 = first; i0 < last; i0 += Block)
+    for (size_t k0 = 0; k0 < prod.m; k0 += Block)
+      for (size_t j0 = 0; j0 < prod.p; j0 += Block)
+      {
+        size_t i1 = min(i0 + Block, last);
+        size_t k1 = min(k0 + Block, prod.m);
+        size_t j1 = min(j0 + Block, prod.p);
+#ifdef X86_KERNELS
+        if (avx2)
+        {
+          blockAvx2(prod, i0, i1, k0, k1, j0, j1);
+          continue;
+        }
+#endif
+        blockScalar(prod, i0, i1, k0, k1, j0, j1);
+      }
+}
+
+struct Task
+{
+  const Product *prod;
+  size_t first, last;
+};
+
+static void *runTask(void *arg)
+{
+  Task *task = static_cast<Task *>(arg);
+  productRows(*task->prod, task->first, task->last);
+  return NULL;
+}
+
+// Rows are split evenly, in multiples of the kernel's 4. A thread
+// that cannot be started leaves its rows to the caller.
+static void product(const Product &prod)
+{
+  size_t threads = MatrixKernels::threads();
+  if (static_cast<double>(prod.n) * prod.m * prod.p < ThreadWork * threads)
+    threads = 1;
+  if (threads == 1)
+  {
+    productRows(prod, 0, prod.n);
+    return;
+  }
+
+  ArrayKernels::level();  // Detected before the threads race for it
+  size_t rows = (prod.n + threads - 1) / threads;
+  rows = (rows + 3) / 4 * 4;
+  Task tasks[MaxThreads];
+  pthread_t ids[MaxThreads];
+  bool started[MaxThreads];
+  for (size_t t=0; t<threads; t++)
+  {
+    tasks[t].prod = &prod;
+    tasks[t].first = min(t * rows, prod.n);
+    tasks[t].last = min((t+1) * rows, prod.n);
+    started[t] = t > 0 && tasks[t].first < tasks[t].last
+      && 0 == pthread_create(&ids[t], NULL, runTask, &tasks[t]);
+  }
+  for (size_t t=0; t<threads; t++)
+    if (!started[t])
+      productRows(prod, tasks[t].first, tasks[t].last);
+  for (size_t t=1; t<threads; t++)
+    if (started[t])
+      pthread_join(ids[t], NULL);
+}
+
+void MatrixKernels::matmul(const double *a, const double *b, double *c,
+    size_t n, size_t m, size_t p)
+{
+  memset(c, 0, n * p * sizeof(double));
+  Product prod = { a, m, b, p, c, p, n, m, p, false };
+  product(prod);
+}
+
+
+// ========= Int products
+
+// c + a*b
+static inline int mulAdd(int c, int a, int b)
+  { return static_cast<unsigned int>(c) + static_cast<unsigned int>(a) * b; }
+
+// As the real products, in plain loops for the compiler to vectorize
+void MatrixKernels::matmul(const int *a, const int *b, int *c, size_t n, size_t m, size_t p)
+{
+  memset(c, 0, n * p * sizeof(int));
+  for (size_t i0 = 0; i0 < n; i0 += Block)
+    for (size_t k0 = 0; k0 < m; k0 += Block)
+      for (size_t j0 = 0; j0 < p; j0 += Block)
+      {
+        size_t i1 = min(i0 + Block, n);
+        size_t k1 = min(k0 + Block, m);
+        size_t j1 = min(j0 + Block, p);
+        for (size_t i = i0; i < i1; i++)
+        {
+          int *row = c + i*p;
+          for (size_t k = k0; k < k1; k++)
+          {
+            int x = a[i*m + k];
+            const int *brow = b + k*p;
+            for (size_t j = j0; j < j1; j++)
+              row[j] = mulAdd(row[j], x, brow[j]);
+          }
+        }
+      }
+}
+
+
+// ========= Matrix by vector, transposition
+
+void MatrixKernels::matvec(const int *a, const int *x, int *y, size_t n, size_t m)
+{
+  for (size_t i=0; i<n; i++)
+    y[i] = ArrayKernels::dot(a + i*m, x, m);
+}
+
+void MatrixKernels::matvec(const double *a, const double *x, double *y, size_t n, size_t m)
+{
+  for (size_t i=0; i<n; i++)
+    y[i] = ArrayKernels::dot(a + i*m, x, m);
+}
+
+// Block by block, so that both the rows read and the columns written
+// stay in cache
+template<class T>
+static void transposeBlocked(const T *a, T *t, size_t r, size_t c)
+{
+  const size_t Block = MatrixKernels::Block / 2;
+  for (size_t i0 = 0; i0 < r; i0 += Block)
+    for (size_t j0 = 0; j0 < c; j0 += Block)
+    {
+      size_t i1 = min(i0 + Block, r);
+      size_t j1 = min(j0 + Block, c);
+      for (size_t i = i0; i < i1; i++)
+        for (size_t j = j0; j < j1; j++)
+          t[j*r + i] = a[i*c + j];
+    }
+}
+
+void MatrixKernels::transpose(const int *a, int *t, size_t r, size_t c)
+{
+  transposeBlocked(a, t, r, c);
+}
+
+void MatrixKernels::transpose(const double *a, double *t, size_t r, size_t c)
+{
+  transposeBlocked(a, t, r, c);
+}
+
+
+// ========= LU factorization
+
+// Right-looking, a block of columns at a time: the panel is factored
+// item by item, then the rows of U right of it, and the rest of the
+// matrix is updated by a single product. Pivoting swaps whole rows.
+bool MatrixKernels::lu(double *a, int *perm, size_t n)
+{
+  bool regular = true;
+  for (size_t i=0; i<n; i++)
+    perm[i] = i;
+  for (size_t k0 = 0; k0 < n; k0 += Block)
+  {
+    size_t k1 = min(k0 + Block, n);
+    for (size_t k = k0; k < k1; k++)
+    {
+      size_t pivot = k;
+      for (size_t i = k+1; i < n; i++)
+        if (fabs(a[i*n + k]) > fabs(a[pivot*n + k]))
+          pivot = i;
+      if (pivot != k)
+      {
+        for (size_t j=0; j<n; j++)
+          swap(a[k*n + j], a[pivot*n + j]);
+        swap(perm[k], perm[pivot]);
+      }
+      double d = a[k*n + k];
+      if (d == 0)
+      {
+        // The column below is all zeroes already
+        regular = false;
+        continue;
+      }
+      for (size_t i = k+1; i < n; i++)
+      {
+        double *row = a + i*n;
+        double l = row[k] /= d;
+        for (size_t j = k+1; j < k1; j++)
+          row[j] -= l * a[k*n + j];
+      }
+    }
+
+    // U12 = L11^-1 A12
+    for (size_t k = k0; k < k1; k++)
+      for (size_t i = k+1; i < k1; i++)
+      {
+        double l = a[i*n + k];
+        for (size_t j = k1; j < n; j++)
+          a[i*n + j] -= l * a[k*n + j];
+      }
+
+    // A22 -= L21 U12
+    if (k1 < n)
+    {
+      Product prod = { a + k1*n + k0, n, a + k0*n + k1, n, a + k1*n + k1, n,
+        n - k1, k1 - k0, n - k1, true };
+      product(prod);
+    }
+  }
+  return regular;
+}
+
+// L Y = P B forward, then U X = Y backward, a whole row of X at a time
+void MatrixKernels::luSolve(const double *lu, const int *perm, const double *b,
+    double *x, size_t n, size_t k)
+{
+  for (size_t i=0; i<n; i++)
+  {
+    double *row = x + i*k;
+    memcpy(row, b + perm[i]*k, k * sizeof(double));
+    for (size_t j=0; j<i; j++)
+    {
+      double l = lu[i*n + j];
+      const double *prev = x + j*k;
+      for (size_t c=0; c<k; c++)
+        row[c] -= l * prev[c];
+    }
+  }
+  for (size_t i=n; i-- > 0; )
+  {
+    double *row = x + i*k;
+    for (size_t j=i+1; j<n; j++)
+    {
+      double u = lu[i*n + j];
+      const double *next = x + j*k;
+      for (size_t c=0; c<k; c++)
+        row[c] -= u * next[c];
+    }
+    double d = lu[i*n + i];
+    for (size_t c=0; c<k; c++)
+      row[c] /= d;
+  }
+}
@@ -0,0 +1,48 @@
+#ifndef MATRIXKERNELS_H
+#define MATRIXKERNELS_H
+
+#include <cstddef>
+
+/**
+ * Dense matrix operations over packed items in row-major order.
+ *
+ * They work on square blocks, small enough for the blocks in use to
+ * stay in cache however large the matrices are. Real products run a
+ * register-blocked AVX2 kernel when ArrayKernels::level() allows,
+ * adding in the same order as the scalar code, so results are the
+ * same at every level. Int arithmetic wraps around as in the executor.
+ *
+ * Large real products, in matmul and lu, split their rows among
+ * MSL_THREADS threads, 1 by default.
+ */
+class MatrixKernels
+{
+  public:
+    // Block side, in items
+    static const size_t Block = 64;
+
+    static size_t threads();
+
+    // C (n x p) = A (n x m) * B (m x p); C is neither A nor B
+    static void matmul(const int *a, const int *b, int *c, size_t n, size_t m, size_t p);
+    static void matmul(const double *a, const double *b, double *c,
+        size_t n, size_t m, size_t p);
+    // y (n) = A (n x m) * x (m)
+    static void matvec(const int *a, const int *x, int *y, size_t n, size_t m);
+    static void matvec(const double *a, const double *x, double *y, size_t n, size_t m);
+    // T (c x r) = A (r x c) transposed; T is not A
+    static void transpose(const int *a, int *t, size_t r, size_t c);
+    static void transpose(const double *a, double *t, size_t r, size_t c);
+
+    // Factors the n x n A in place into L below the diagonal (its unit
+    // diagonal left out) and U on and above it, pivoting on the largest
+    // item of each column: row i of L*U is row perm[i] of A. Returns
+    // false if U has a zero on the diagonal.
+    static bool lu(double *a, int *perm, size_t n);
+    // X (n x k) solving A X = B, given the factors of A by lu with no
+    // zero pivot
+    static void luSolve(const double *lu, const int *perm, const double *b,
+        double *x, size_t n, size_t k);
+};
+
+#endif // MATRIXKERNELS_H
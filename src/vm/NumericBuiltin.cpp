@@ -0,0 +1,224 @@
+#include <cstring>
+#include "NumericBuiltin.h"
+#include "ArrayKernels.h"
+#include "MatrixKernels.h"
+
+
+const ListedBuiltin::Definition NumericBuiltin::defs[] =
+{
+  {"matmul", NumericBuiltin::matmul},
+  {"matvec", NumericBuiltin::matvec},
+  {"transpose", NumericBuiltin::transpose},
+  {"lu", NumericBuiltin::lu},
+  {"solve", NumericBuiltin::solve},
+};
+
+NumericBuiltin::NumericBuiltin(StringTable *strings)
+  : ListedBuiltin(strings, defs, sizeof(defs)/sizeof(ListedBuiltin::Definition))
+{
+}
+
+namespace
+{
+  // The items of an array as reals: its own for Reals arrays, else a
+  // copy. Boxed items must be numbers.
+  class RealItems
+  {
+    public:
+      RealItems(const ArrayStorage &arrays, const Value &a)
+        : m_items(NULL), m_copy(NULL)
+      {
+        size_t n = arrays.size(a);
+        switch (arrays.kind(a))
+        {
+          case ArrayStorage::Reals:
+            m_items = arrays.reals(a);
+            return;
+          case ArrayStorage::Ints:
+            m_items = m_copy = new double[n];
+            ArrayKernels::widen(arrays.ints(a), m_copy, n);
+            return;
+          default:
+            m_items = m_copy = new double[n];
+            for (size_t i=0; i<n; i++)
+            {
+              Value v = arrays.getUnchecked(a, i+1);
+              if (v.type() != Value::Int && v.type() != Value::Real)
+              {
+                delete[] m_copy;
+                throw Value::TypeMismatch();
+              }
+              m_copy[i] = v.toReal();
+            }
+        }
+      }
+      ~RealItems() { delete[] m_copy; }
+
+      const double *items() const { return m_items; }
+
+    private:
+      RealItems(const RealItems &);
+      RealItems &operator =(const RealItems &);
+
+      const double *m_items;
+      double *m_copy;
+  };
+}
+
+// Rows and columns of a 2-dimensional array
+static void matrixDims(const ArrayStorage &arrays, const Value &a, size_t &rows, size_t &cols)
+{
+  if (arrays.rank(a) != 2)
+    throw ArrayStorage::BadSize();
+  rows = arrays.extent(a, 0);
+  cols = arrays.extent(a, 1);
+}
+
+void NumericBuiltin::matmul(ListedBuiltin *, Context &context)
+{
+  CallArgs args(context, 2);
+  ArrayStorage &arrays = context.arrays;
+  Value a = args.array(0);
+  Value b = args.array(1);
+  size_t n, m, inner, p;
+  matrixDims(arrays, a, n, m);
+  matrixDims(arrays, b, inner, p);
+  if (inner != m)
+    throw ArrayStorage::SizeMismatch();
+
+  int dims[] = { static_cast<int>(n), static_cast<int>(p) };
+  if (arrays.kind(a) == ArrayStorage::Ints && arrays.kind(b) == ArrayStorage::Ints)
+  {
+    Value c = arrays.alloc(dims, 2, ArrayStorage::Ints);
+    MatrixKernels::matmul(arrays.ints(a), arrays.ints(b), arrays.writableInts(c), n, m, p);
+    args.ret(c);
+    return;
+  }
+  RealItems itemsA(arrays, a);
+  RealItems itemsB(arrays, b);
+  Value c = arrays.alloc(dims, 2, ArrayStorage::Reals);
+  MatrixKernels::matmul(itemsA.items(), itemsB.items(), arrays.writableReals(c), n, m, p);
+  args.ret(c);
+}
+
+void NumericBuiltin::matvec(ListedBuiltin *, Context &context)
+{
+  CallArgs args(context, 2);
+  ArrayStorage &arrays = context.arrays;
+  Value a = args.array(0);
+  Value x = args.array(1);
+  size_t n, m;
+  matrixDims(arrays, a, n, m);
+  if (arrays.size(x) != m)
+    throw ArrayStorage::SizeMismatch();
+
+  if (arrays.kind(a) == ArrayStorage::Ints && arrays.kind(x) == ArrayStorage::Ints)
+  {
+    Value y = arrays.alloc(n, ArrayStorage::Ints);
+    MatrixKernels::matvec(arrays.ints(a), arrays.ints(x), arrays.writableInts(y), n, m);
+    args.ret(y);
+    return;
+  }
+  RealItems itemsA(arrays, a);
+  RealItems itemsX(arrays, x);
+  Value y = arrays.alloc(n, ArrayStorage::Reals);
+  MatrixKernels::matvec(itemsA.items(), itemsX.items(), arrays.writableReals(y), n, m);
+  args.ret(y);
+}
+
+void NumericBuiltin::transpose(ListedBuiltin *, Context &context)
+{
+  CallArgs args(context, 1);
+  ArrayStorage &arrays = context.arrays;
+  Value a = args.array(0);
+  size_t r, c;
+  matrixDims(arrays, a, r, c);
+
+  int dims[] = { static_cast<int>(c), static_cast<int>(r) };
+  Value t = arrays.alloc(dims, 2, arrays.kind(a));
+  switch (arrays.kind(a))
+  {
+    case ArrayStorage::Ints:
+      MatrixKernels::transpose(arrays.ints(a), arrays.writableInts(t), r, c);
+      break;
+    case ArrayStorage::Reals:
+      MatrixKernels::transpose(arrays.reals(a), arrays.writableReals(t), r, c);
+      break;
+    default:
+      for (size_t i=0; i<r; i++)
+        for (size_t j=0; j<c; j++)
+          arrays.setUnchecked(t, j*r + i + 1, arrays.getUnchecked(a, i*c + j + 1));
+  }
+  args.ret(t);
+}
+
+// Side of a square matrix
+static size_t squareDims(const ArrayStorage &arrays, const Value &a)
+{
+  size_t rows, cols;
+  matrixDims(arrays, a, rows, cols);
+  if (rows != cols)
+    throw ArrayStorage::BadSize();
+  return rows;
+}
+
+void NumericBuiltin::lu(ListedBuiltin *, Context &context)
+{
+  CallArgs args(context, 1);
+  ArrayStorage &arrays = context.arrays;
+  Value a = args.array(0);
+  size_t n = squareDims(arrays, a);
+
+  RealItems items(arrays, a);
+  int dims[] = { static_cast<int>(n), static_cast<int>(n) };
+  Value factors = arrays.alloc(dims, 2, ArrayStorage::Reals);
+  // Kept reachable while the rows are allocated
+  context.push(factors);
+  Value rows = arrays.alloc(n, ArrayStorage::Ints);
+  context.stack.pop();
+
+  double *lu = arrays.writableReals(factors);
+  int *perm = arrays.writableInts(rows);
+  memcpy(lu, items.items(), n * n * sizeof(double));
+  MatrixKernels::lu(lu, perm, n);
+  for (size_t i=0; i<n; i++)
+    perm[i]++;
+  args.ret(factors, rows);
+}
+
+void NumericBuiltin::solve(ListedBuiltin *, Context &context)
+{
+  CallArgs args(context, 2);
+  ArrayStorage &arrays = context.arrays;
+  Value a = args.array(0);
+  Value b = args.array(1);
+  size_t n = squareDims(arrays, a);
+  size_t k = 1;
+  if (arrays.rank(b) == 2)
+  {
+    if (arrays.extent(b, 0) != n)
+      throw ArrayStorage::SizeMismatch();
+    k = arrays.extent(b, 1);
+  }
+  else if (arrays.rank(b) != 1)
+    throw ArrayStorage::BadSize();
+  else if (arrays.size(b) != n)
+    throw ArrayStorage::SizeMismatch();
+
+  RealItems itemsA(arrays, a);
+  RealItems itemsB(arrays, b);
+  Value x = arrays.alloc(n * k, ArrayStorage::Reals);
+  arrays.reshapeLike(x, b);
+
+  double *lu = new double[n * n];
+  int *perm = new int[n];
+  memcpy(lu, itemsA.items(), n * n * sizeof(double));
+  bool regular = MatrixKernels::lu(lu, perm, n);
+  if (regular)
+    MatrixKernels::luSolve(lu, perm, itemsB.items(), arrays.writableReals(x), n, k);
+  delete[] lu;
+  delete[] perm;
+  if (!regular)
+    throw Singular();
+  args.ret(x);
+}
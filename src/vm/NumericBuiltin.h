@@ -0,0 +1,40 @@
+#ifndef NUMERICBUILTIN_H
+#define NUMERICBUILTIN_H
+
+#include "Builtin.h"
+
+/**
+ * Matrix operations over 2-dimensional arrays:
+ *   matmul [A, B]   product of A (n x m) and B (m x p), n x p
+ *   matvec [A, X]   product of A (n x m) and the m items of X, size n
+ *   transpose A     A (r x c) transposed, c x r
+ *   lu A            [LU, P]: the LU factors of A (n x n), as by
+ *                   MatrixKernels::lu, and the rows of A they are
+ *                   for, numbered from 1
+ *   solve [A, B]    X such that A X = B, for A (n x n) and B of size n,
+ *                   or n x k
+ *
+ * Products of two Ints arrays are Ints, of any other numbers Reals.
+ * A transpose is of the kind of A, boxed items included. lu and solve
+ * work in reals; solve throws Singular when A is. The work is done by
+ * MatrixKernels.
+ */
+class NumericBuiltin: public ListedBuiltin
+{
+  public:
+    // Exceptions
+    class Singular {};
+
+    NumericBuiltin(StringTable *strings);
+
+  private:
+    static void matmul(ListedBuiltin *self, Context &context);
+    static void matvec(ListedBuiltin *self, Context &context);
+    static void transpose(ListedBuiltin *self, Context &context);
+    static void lu(ListedBuiltin *self, Context &context);
+    static void solve(ListedBuiltin *self, Context &context);
+
+    static const ListedBuiltin::Definition defs[];
+};
+
+#endif // NUMERICBUILTIN_H
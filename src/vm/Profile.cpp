@@ -0,0 +1,105 @@
+#include <cstring>
+#include "Profile.h"
+#include "File.h"
+
+static const int formatVersion = 1;
+
+Profile::Profile(const Program &prog, unsigned int sourceHash)
+  : m_prog(prog), m_sourceHash(sourceHash), m_sites(prog.size())
+{
+}
+
+size_t Profile::entryEnd(size_t entry) const
+{
+  // Functions are compiled one after another
+  if (entry+1 < m_prog.entryCount())
+    return m_prog.entry(entry+1).addr;
+  else
+    return m_prog.size();
+}
+
+void Profile::save(const char *filename) const
+{
+  File file(filename, File::Write);
+  file.printf("msl-profile %d %08x\n", formatVersion, m_sourceHash);
+  for (size_t i=0; i<m_prog.entryCount(); i++)
+  {
+    const Program::EntryPoint &e = m_prog.entry(i);
+    size_t end = entryEnd(i);
+    file.printf("fun %s %lu\n", e.name.c_str(), 
+        static_cast<unsigned long>(end - e.addr));
+    for (size_t addr = e.addr; addr < end; addr++)
+      if (m_sites[addr].count > 0)
+        file.printf("site %lu %lu %x\n", 
+            static_cast<unsigned long>(addr - e.addr),
+            m_sites[addr].count, m_sites[addr].types);
+  }
+}
+
+void Profile::load(const char *filename)
+{
+  File file(filename, File::Read);
+
+  int version;
+  unsigned int hash;
+  if (file.scanf("msl-profile %d %x", &version, &hash) != 2
+      || version != formatVersion)
+    throw Exception("Not a profile");
+  if (hash != m_sourceHash)
+    throw Exception("Profile belongs to a different source");
+
+  // Address range of the function being read, empty if skipped
+  size_t begin = 0, end = 0; 
+  char tag[16];
+  while (file.scanf("%15s", tag) == 1)
+  {
+    if (0 == strcmp(tag, "fun"))
+    {
+      char name[256];
+      unsigned long size;
+      if (file.scanf("%255s %lu", name, &size) != 2)
+        throw Exception("Malformed function record");
+
+      begin = end = 0;
+      for (size_t i=0; i<m_prog.entryCount(); i++)
+        if (m_prog.entry(i).name == name 
+            && entryEnd(i) - m_prog.entry(i).addr == size)
+        {
+          begin = m_prog.entry(i).addr;
+          end = entryEnd(i);
+        }
+    }
+    else if (0 == strcmp(tag, "site"))
+    {
+      unsigned long offset, count;
+      unsigned int types;
+      if (file.scanf("%lu %lu %x", &offset, &count, &types) != 3)
+        throw Exception("Malformed site record");
+      if (begin + offset < end)
+      {
+        m_sites[begin + offset].count += count;
+        m_sites[begin + offset].types |= types;
+      }
+    }
+    else
+      throw Exception("Malformed profile");
+  }
+}
+
+size_t Profile::specialize(Program &prog) const
+{
+  size_t n = 0;
+  for (size_t addr=0; addr<prog.size(); addr++)
+  {
+    Instruction &instr = prog[addr];
+    Instruction::Opcode special = Instruction::intVariant(instr.opcode);
+    if (special != instr.opcode
+        && m_sites[addr].count > 0
+        && m_sites[addr].types == typeBit(Value::Int))
+    {
+      instr.opcode = special;
+      n++;
+    }
+  }
+  return n;
+}
@@ -0,0 +1,68 @@
+#ifndef PROFILE_H
+#define PROFILE_H
+
+#include "Vector.h"
+#include "Program.h"
+#include "Value.h"
+
+/**
+ * An execution profile: per-instruction hit counts and type feedback.
+ *
+ * The Executor records into a Profile while running. A profile may be
+ * saved and loaded by a later run of the same source (it is keyed to the 
+ * source hash), so that load-time passes need no warm-up.
+ *
+ * Sites are stored per function, by offset from the entry point: 
+ * a function whose code size has changed is not loaded.
+ */
+class Profile
+{
+  public:
+    // Exception
+    class Exception
+    {
+      public:
+        Exception(const char *text)
+          : m_text(text) {}
+        const char *text() const { return m_text; }
+      private:
+        const char *m_text;
+    };
+
+    Profile(const Program &prog, unsigned int sourceHash);
+
+    // Recording
+    void hit(size_t addr) { m_sites[addr].count++; }
+    void recordType(size_t addr, Value::Type t) { m_sites[addr].types |= typeBit(t); }
+
+    // Queries
+    unsigned long count(size_t addr) const { return m_sites[addr].count; }
+    unsigned int types(size_t addr) const { return m_sites[addr].types; }
+    unsigned long calls(size_t entry) const { return count(m_prog.entry(entry).addr); }
+
+    static unsigned int typeBit(Value::Type t) { return 1u << t; }
+
+    // Persistence
+    void save(const char *filename) const;
+    void load(const char *filename);
+
+    // Load-time specialization of monomorphic sites.
+    // Returns the number of instructions rewritten.
+    size_t specialize(Program &prog) const;
+
+  private:
+    struct Site
+    {
+      Site(): count(0), types(0) {}
+      unsigned long count;
+      unsigned int types;
+    };
+
+    size_t entryEnd(size_t entry) const;
+    
+    const Program &m_prog;
+    unsigned int m_sourceHash;
+    Vector<Site> m_sites;
+};
+
+#endif // PROFILE_H
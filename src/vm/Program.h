@@ -25,6 +25,33 @@ class Program
       return m_instrs.size()-1;
     }
 
+    // Replace the code in [begin, end), relocating the jumps and 
+    // entry points that follow
+    void splice(size_t begin, size_t end, const Vector<Instruction> &code)
+    {
+      Vector<Instruction> instrs;
+      for (size_t i=0; i<begin; i++)
+        instrs.push_back(m_instrs[i]);
+      for (size_t i=0; i<code.size(); i++)
+        instrs.push_back(code[i]);
+      for (size_t i=end; i<m_instrs.size(); i++)
+      {
+        Instruction instr = m_instrs[i];
+        if (instr.hasAddress() && instr.arg.addr >= end)
+          instr.arg.addr = instr.arg.addr - end + begin + code.size();
+        instrs.push_back(instr);
+      }
+      m_instrs = instrs;
+
+      for (size_t i=0; i<m_entries.size(); i++)
+        if (m_entries[i].addr >= end)
+          m_entries[i].addr = m_entries[i].addr - end + begin + code.size();
+    }
+
+    // Replace all the code with that of code, leaving the entry points
+    // and globals as they are
+    void replaceCode(const Program &code) { m_instrs = code.m_instrs; }
+
     size_t size() const { return m_instrs.size(); }
     size_t nextAddr() const { return m_instrs.size(); }
 
@@ -34,6 +61,7 @@ class Program
     size_t entryCount() const { return m_entries.size(); }
     const EntryPoint &entry(size_t i) const { return m_entries[i]; }
     void addEntry(const EntryPoint &e) { m_entries.push_back(e); }
+    void moveEntry(size_t i, size_t addr) { m_entries[i].addr = addr; }
 
     size_t globalsCount() const { return m_globals.size(); }
     StringTable::Ref global(size_t i) const { return m_globals[i]; }
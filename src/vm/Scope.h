@@ -15,11 +15,26 @@ class Scope
     // Exception
     class VarNotFound {};
 
+    Scope(): m_regionMark(0) {}
+
     Value getVar(StringTable::Ref id) const;
     void setVar(StringTable::Ref id, const Value &val);
     bool isVar(StringTable::Ref id) const;
+
+    // Introspection
+    size_t varCount() const { return m_vars.size(); }
+    const Value &varAt(size_t i) const { return m_vars.valueAt(i); }
+
+    // Arrays released along with the scope
+    void ownArray(const Value &ref) { m_arrays.push_back(ref); }
+    const Vector<Value> &ownedArrays() const { return m_arrays; }
+    // ArrayStorage::regionMark when the scope was opened
+    void setRegionMark(size_t mark) { m_regionMark = mark; }
+    size_t regionMark() const { return m_regionMark; }
   private:
     Map<StringTable::Ref, Value> m_vars;
+    Vector<Value> m_arrays;
+    size_t m_regionMark;
 };
 
 #endif // SCOPE_H
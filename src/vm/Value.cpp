@@ -51,6 +51,8 @@ VAL_NUM_OPERATOR(>)
 VAL_NUM_OPERATOR(<)
 
 VAL_OPERATOR(Int, %)
+VAL_OPERATOR(Int, >>)
+VAL_OPERATOR(Int, &)
 VAL_OPERATOR(Bool, &&)
 VAL_OPERATOR(Bool, ||)
 
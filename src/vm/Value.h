@@ -18,7 +18,7 @@ class Value
     enum Type
     {
       TupOpen, TupClose,
-      Int, Real, Bool, String, Array
+      Int, Real, Bool, String, Array, Dict
     };
 
     Value(int i=0):                  m_type(Int)    { d.asInt    = i; }
@@ -26,6 +26,8 @@ class Value
     Value(bool b):                   m_type(Bool)   { d.asBool   = b; }
     Value(const Atom &a):            m_type(String) { d.asHandle = a.id(); }
     Value(Type t, unsigned int h=0): m_type(t)      { d.asHandle = h; }
+    Value(Type t, unsigned int h, unsigned int gen): m_type(t)
+      { d.asRef.handle = h; d.asRef.generation = gen; }
 
     Type type() const { return m_type; }
 
@@ -34,16 +36,31 @@ class Value
     bool              asBool()   const { ensureType(Bool);   return d.asBool;   }
     StringTable::Ref  asString() const { ensureType(String); return d.asHandle; }
     unsigned int      asArray()  const { ensureType(Array);  return d.asHandle; }
+    // Generation of the array slot the handle was made for
+    unsigned int arrayGeneration() const { ensureType(Array); return d.asRef.generation; }
+    // Slot and generation of an array or a dictionary (see ArrayStorage)
+    unsigned int handle() const { ensureRef(); return d.asRef.handle; }
+    unsigned int generation() const { ensureRef(); return d.asRef.generation; }
 
     double toReal() const;
   private:
     void ensureType(Type t) const;
+    void ensureRef() const
+    {
+      if (m_type != Array && m_type != Dict)
+        throw TypeMismatch();
+    }
     union Data
     {
       int asInt;
       double asReal;
       bool asBool;
       unsigned int asHandle;
+      struct
+      {
+        unsigned int handle; // Same as asHandle
+        unsigned int generation;
+      } asRef;
     };
 
     Type m_type;
@@ -55,6 +72,8 @@ Value operator -(const Value &a, const Value &b);
 Value operator *(const Value &a, const Value &b);
 Value operator /(const Value &a, const Value &b);
 Value operator %(const Value &a, const Value &b);
+Value operator >>(const Value &a, const Value &b);
+Value operator &(const Value &a, const Value &b);
 Value operator >(const Value &a, const Value &b);
 Value operator <(const Value &a, const Value &b);
 Value operator >=(const Value &a, const Value &b);